@@ -0,0 +1,84 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "anel.h"
+
+static void liberaDados(Anel *anel) {
+    if (anel->pool && anel->dados && anel->capacidade == anel->pool->tamanho) poolLibera(anel->pool, anel->dados);
+    else free(anel->dados);
+}
+
+int anelReserva(Anel *anel, size_t capacidade) {
+    if (capacidade <= anel->capacidade) return 0;
+    size_t nova = anel->capacidade ? anel->capacidade : 64;
+    if (anel->pool && nova < anel->pool->tamanho) nova = anel->pool->tamanho;
+    while (nova < capacidade) nova *= 2;
+
+    // Copia os dados já em ordem para o começo do novo buffer
+    uint8_t *dados = anel->pool && nova == anel->pool->tamanho ? poolAloca(anel->pool) : malloc(nova);
+    if (!dados) {
+        anel->erro = true;
+        return -1;
+    }
+    if (anel->tamanho) anelCopia(anel, 0, dados, anel->tamanho);
+    liberaDados(anel);
+    anel->dados = dados;
+    anel->capacidade = nova;
+    anel->inicio = 0;
+    return 0;
+}
+
+int anelEscreve(Anel *anel, const void *origem, size_t n) {
+    if (n == 0) return 0;
+    if (anel->tamanho + n > anel->capacidade && anelReserva(anel, anel->tamanho + n) == -1) return -1;
+    size_t fim = (anel->inicio + anel->tamanho) & (anel->capacidade - 1);
+    size_t primeiro = anel->capacidade - fim < n ? anel->capacidade - fim : n;
+    memcpy(anel->dados + fim, origem, primeiro);
+    memcpy(anel->dados, (const uint8_t *)origem + primeiro, n - primeiro);
+    anel->tamanho += n;
+    return 0;
+}
+
+void anelCopia(const Anel *anel, size_t deslocamento, void *destino, size_t n) {
+    size_t pos = (anel->inicio + deslocamento) & (anel->capacidade - 1);
+    size_t primeiro = anel->capacidade - pos < n ? anel->capacidade - pos : n;
+    memcpy(destino, anel->dados + pos, primeiro);
+    memcpy((uint8_t *)destino + primeiro, anel->dados, n - primeiro);
+}
+
+int anelOcupados(const Anel *anel, struct iovec iov[2]) {
+    if (anel->tamanho == 0) return 0;
+    size_t primeiro = anel->capacidade - anel->inicio;
+    if (primeiro >= anel->tamanho) {
+        iov[0] = (struct iovec){anel->dados + anel->inicio, anel->tamanho};
+        return 1;
+    }
+    iov[0] = (struct iovec){anel->dados + anel->inicio, primeiro};
+    iov[1] = (struct iovec){anel->dados, anel->tamanho - primeiro};
+    return 2;
+}
+
+int anelLivres(const Anel *anel, struct iovec iov[2]) {
+    size_t livres = anel->capacidade - anel->tamanho;
+    if (livres == 0) return 0;
+    size_t fim = (anel->inicio + anel->tamanho) & (anel->capacidade - 1);
+    size_t primeiro = anel->capacidade - fim;
+    if (primeiro >= livres) {
+        iov[0] = (struct iovec){anel->dados + fim, livres};
+        return 1;
+    }
+    iov[0] = (struct iovec){anel->dados + fim, primeiro};
+    iov[1] = (struct iovec){anel->dados, livres - primeiro};
+    return 2;
+}
+
+void anelEncolhe(Anel *anel, size_t limite) {
+    if (anel->tamanho || anel->capacidade <= limite) return;
+    liberaAnel(anel);
+}
+
+void liberaAnel(Anel *anel) {
+    liberaDados(anel);
+    anel->dados = NULL;
+    anel->capacidade = anel->inicio = anel->tamanho = 0;
+}
@@ -0,0 +1,54 @@
+#ifndef ANEL_H
+#define ANEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <sys/uio.h>
+
+#include "pool.h"
+
+// Buffer circular de bytes de uma conexão. A capacidade é sempre potência de 2, então a
+// posição real é só uma máscara; quando os dados dão a volta no fim do buffer eles são
+// expostos como dois iovecs, para ler ou escrever tudo com uma única chamada ao kernel.
+
+typedef struct {
+    uint8_t *dados;
+    size_t capacidade; // Potência de 2 (0 enquanto nada foi alocado)
+    size_t inicio;     // Posição do primeiro byte ocupado
+    size_t tamanho;    // Bytes ocupados
+    bool erro;         // Faltou memória para crescer; a conexão deve ser encerrada
+    Pool *pool;        // Se definido, buffers do tamanho do objeto do pool vêm dele
+} Anel;
+
+// Acrescenta `n` bytes, dobrando a capacidade se preciso. Retorna -1 sem memória
+int anelEscreve(Anel *anel, const void *origem, size_t n);
+
+// Copia `n` bytes a partir de `deslocamento` (relativo ao início) sem consumi-los
+void anelCopia(const Anel *anel, size_t deslocamento, void *destino, size_t n);
+
+// Ponteiro para `n` bytes a partir de `deslocamento`, ou NULL se eles dão a volta no buffer
+static inline const uint8_t *anelContiguo(const Anel *anel, size_t deslocamento, size_t n) {
+    size_t pos = (anel->inicio + deslocamento) & (anel->capacidade - 1);
+    return pos + n <= anel->capacidade ? anel->dados + pos : NULL;
+}
+
+static inline void anelConsome(Anel *anel, size_t n) {
+    anel->inicio = (anel->inicio + n) & (anel->capacidade - 1);
+    anel->tamanho -= n;
+    if (anel->tamanho == 0) anel->inicio = 0; // Mantém o próximo lote contíguo
+}
+
+// Trechos ocupados (para enviar) ou livres (para receber). Retornam quantos iovecs foram usados
+int anelOcupados(const Anel *anel, struct iovec iov[2]);
+int anelLivres(const Anel *anel, struct iovec iov[2]);
+
+// Garante ao menos `capacidade` bytes (potência de 2). Retorna -1 sem memória
+int anelReserva(Anel *anel, size_t capacidade);
+
+// Devolve a memória se o anel está vazio e cresceu além de `limite` (depois de um mapa grande)
+void anelEncolhe(Anel *anel, size_t limite);
+
+void liberaAnel(Anel *anel);
+
+#endif
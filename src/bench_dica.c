@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "labirinto.h"
+#include "busca.h"
+#include "gerador.h"
+
+// Microbenchmark de buscaCaminho: latência de uma dica em função do tamanho do labirinto.
+// Também mede a geração do labirinto (com a tabela de distâncias) por linha e compara os
+// motores de busca em labirintos perfeitos e em áreas abertas com obstáculos e duas saídas.
+// Uso: bench_dica [lado_maximo] [repeticoes]
+
+static double agora(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Área aberta: 25% de paredes espalhadas, entrada em (0,0) e saídas nos cantos da direita
+static int geraAberto(Labirinto *lab, int lado, uint64_t semente) {
+    uint8_t *celulas = malloc((size_t)lado * lado);
+    if (!celulas) return -1;
+    uint64_t estado = semente * 0x9E3779B97F4A7C15ull | 1;
+    for (size_t c = 0; c < (size_t)lado * lado; c++) {
+        estado ^= estado << 13;
+        estado ^= estado >> 7;
+        estado ^= estado << 17;
+        celulas[c] = estado % 4 == 0 ? WALL : PATH;
+    }
+    celulas[0] = ENTRY;
+    celulas[lado - 1] = EXIT;
+    celulas[(size_t)lado * lado - 1] = EXIT;
+    int resultado = montaLabirinto(lab, lado, lado, celulas);
+    free(celulas);
+    return resultado;
+}
+
+// Confere que o caminho termina numa saída
+static int caminhoValido(const Labirinto *lab, int x, int y, const Caminho *caminho) {
+    for (size_t i = 0; i < caminho->tamanho; i++) {
+        int antes[2] = {x, y};
+        if (atualizaPosicaoJogador(lab, &x, &y, caminho->passos[i]) == 1 && antes[0] == x && antes[1] == y) return 0;
+    }
+    return tipoCelula(lab, x, y) == EXIT;
+}
+
+// Uma linha por motor; o tamanho do caminho de todos precisa ser o da BFS
+static int comparaMotores(const char *tipo, const Labirinto *lab, int x, int y, int n, AreaBusca *area, Caminho *caminho) {
+    size_t esperado = 0;
+    for (int motor = MOTOR_BFS; motor < NUM_MOTORES; motor++) {
+        if (buscaComMotor(motor, lab, x, y, area, caminho) == -1) {
+            fprintf(stderr, "Memória insuficiente\n");
+            return -1;
+        }
+        double inicio = agora();
+        for (int r = 0; r < n; r++) buscaComMotor(motor, lab, x, y, area, caminho);
+        double por_dica = (agora() - inicio) / n;
+
+        if (motor == MOTOR_BFS) esperado = caminho->tamanho;
+        const char *situacao = caminho->tamanho != esperado ? "TAMANHO DIFERENTE"
+                             : caminho->tamanho && !caminhoValido(lab, x, y, caminho) ? "CAMINHO INVALIDO" : "ok";
+        printf("%-9s %8d %-13s %10zu %14llu %14.1f  %s\n", tipo, lab->linhas, nomeMotor(motor), caminho->tamanho,
+               (unsigned long long)area->expandidos, por_dica * 1e6, situacao);
+        if (strcmp(situacao, "ok") != 0) return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    int lado_maximo = argc > 1 ? atoi(argv[1]) : 4095;
+    int repeticoes = argc > 2 ? atoi(argv[2]) : 20;
+
+    AreaBusca area = {0};
+    Caminho caminho = {0};
+
+    printf("%8s %12s %10s %14s %14s %14s %14s\n", "lado", "celulas", "passos", "us/dica", "ns/celula", "us/tabela",
+           "us/linha_ger");
+    for (int lado = 15; lado <= lado_maximo; lado = lado * 2 + 1) {
+        Labirinto lab;
+        double gerado = agora();
+        if (geraLabirinto(&lab, lado, 1) == -1) {
+            perror("Erro ao gerar o labirinto");
+            return EXIT_FAILURE;
+        }
+        double por_linha = (agora() - gerado) / lado;
+
+        // Primeira chamada fora da medição: aloca a área de busca
+        buscaCaminho(&lab, 1, 1, &area, &caminho);
+
+        int n = lado >= 1023 ? (repeticoes + 9) / 10 : repeticoes;
+        double inicio = agora();
+        for (int r = 0; r < n; r++) {
+            if (buscaCaminho(&lab, 1, 1, &area, &caminho) == -1) {
+                fprintf(stderr, "Memória insuficiente\n");
+                return EXIT_FAILURE;
+            }
+        }
+        double por_dica = (agora() - inicio) / n;
+        size_t celulas = (size_t)lado * lado;
+
+        // Mesma dica seguindo a tabela de distâncias pré-calculada
+        inicio = agora();
+        for (int r = 0; r < n; r++) {
+            caminhoPorDistancias(&lab, 1, 1, &caminho);
+        }
+        double por_tabela = (agora() - inicio) / n;
+
+        printf("%8d %12zu %10zu %14.1f %14.2f %14.1f %14.2f\n", lado, celulas, caminho.tamanho, por_dica * 1e6,
+               por_dica * 1e9 / celulas, por_tabela * 1e6, por_linha * 1e6);
+        liberaLabirinto(&lab);
+    }
+
+    printf("\n%-9s %8s %-13s %10s %14s %14s\n", "tipo", "lado", "motor", "passos", "expandidos", "us/dica");
+    int falhou = 0;
+    for (int lado = 255; lado <= lado_maximo; lado = lado * 2 + 1) {
+        int n = lado >= 1023 ? (repeticoes + 9) / 10 : repeticoes;
+        Labirinto lab;
+        if (geraLabirinto(&lab, lado, 1) == -1) {
+            perror("Erro ao gerar o labirinto");
+            return EXIT_FAILURE;
+        }
+        falhou |= comparaMotores("perfeito", &lab, 1, 1, n, &area, &caminho);
+        liberaLabirinto(&lab);
+
+        if (geraAberto(&lab, lado, lado) == -1) {
+            perror("Erro ao gerar o labirinto");
+            return EXIT_FAILURE;
+        }
+        falhou |= comparaMotores("aberto", &lab, 0, 0, n, &area, &caminho);
+        liberaLabirinto(&lab);
+    }
+
+    liberaCaminho(&caminho);
+    liberaAreaBusca(&area);
+    return falhou ? EXIT_FAILURE : EXIT_SUCCESS;
+}
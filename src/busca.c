@@ -0,0 +1,489 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "busca.h"
+
+#define ORIGEM 5  // Marca da célula inicial em AreaBusca.direcao
+#define VOLTA 8   // Bidirecional: célula alcançada a partir das saídas (os bits baixos apontam o passo rumo a ela)
+#define FECHADA 16 // JPS: ponto de salto já expandido
+
+static const char *nomes_motores[NUM_MOTORES] = {
+    [MOTOR_TABELA] = "tabela", [MOTOR_BFS] = "bfs", [MOTOR_ASTAR] = "astar",
+    [MOTOR_BIDIRECIONAL] = "bidirecional", [MOTOR_JPS] = "jps",
+};
+
+static const int oposta[5] = {0, 3, 4, 1, 2};
+
+int motorPorNome(const char *nome) {
+    for (int m = 0; m < NUM_MOTORES; m++) {
+        if (strcmp(nome, nomes_motores[m]) == 0) return m;
+    }
+    return -1;
+}
+
+const char *nomeMotor(int motor) {
+    return motor >= 0 && motor < NUM_MOTORES ? nomes_motores[motor] : "?";
+}
+
+size_t filasMotor(int motor) {
+    if (motor == MOTOR_TABELA) return 0;
+    return motor == MOTOR_BFS ? 1 : 2;
+}
+
+bool usaCusto(int motor) {
+    return motor == MOTOR_ASTAR || motor == MOTOR_JPS;
+}
+
+static int reservaCaminho(Caminho *caminho, size_t tamanho) {
+    if (tamanho <= caminho->capacidade) return 0;
+    uint8_t *passos = realloc(caminho->passos, tamanho);
+    if (!passos) return -1;
+    caminho->passos = passos;
+    caminho->capacidade = tamanho;
+    return 0;
+}
+
+// Só cresce; labirintos menores reaproveitam a área já alocada. Áreas vindas de fora (a arena
+// da sessão) já têm a capacidade e os planos que o motor usa
+static int reservaAreaBusca(AreaBusca *area, size_t total, bool usa_custo) {
+    if (total <= area->capacidade && (area->custo || !usa_custo)) return 0;
+    uint8_t *direcao = realloc(area->direcao, total);
+    if (direcao) area->direcao = direcao;
+    int32_t *fila = realloc(area->fila, 2 * total * sizeof(int32_t));
+    if (fila) area->fila = fila;
+    int32_t *custo = realloc(area->custo, total * sizeof(int32_t));
+    if (custo) area->custo = custo;
+    if (!direcao || !fila || !custo) return -1;
+    area->capacidade = total;
+    return 0;
+}
+
+// BFS que guarda apenas a direção de chegada de cada célula (1 byte); o caminho é
+// reconstruído da saída até a origem uma única vez.
+// Retorna -1 se faltar memória; caminho->tamanho fica 0 se não houver saída alcançável
+int buscaCaminho(const Labirinto *lab, int start_x, int start_y, AreaBusca *area, Caminho *caminho) {
+    size_t total = (size_t)lab->linhas * lab->colunas;
+    caminho->tamanho = 0;
+    if (reservaAreaBusca(area, total, false) == -1) return -1;
+
+    uint8_t *direcao = area->direcao;
+    int32_t *queue = area->fila;
+    memset(direcao, 0, total);
+
+    int32_t colunas = lab->colunas;
+    int32_t deslocamento[5] = {0, -colunas, 1, colunas, -1}; // Indexado pela direção
+    size_t front = 0, rear = 0;
+    int32_t inicio = (int32_t)((size_t)start_x * colunas + start_y);
+    queue[rear++] = inicio;
+    direcao[inicio] = ORIGEM;
+    int32_t fim = -1;
+
+    while (front < rear) {
+        int32_t current = queue[front++];
+        if (tipoIndice(lab, current) == EXIT) {
+            fim = current;
+            break;
+        }
+
+        int pos[2] = {current / colunas, current % colunas};
+        uint8_t livres = movimentosValidos(lab, pos);
+        for (int d = 1; d <= 4; d++) {
+            if (!(livres & (1 << (d - 1)))) continue;
+            int32_t proximo = current + deslocamento[d];
+            if (direcao[proximo] == 0) {
+                direcao[proximo] = (uint8_t)d;
+                queue[rear++] = proximo;
+            }
+        }
+    }
+
+    area->expandidos = front;
+    if (fim == -1) return 0;
+
+    // Contar os passos e depois preencher de trás para frente
+    size_t passos = 0;
+    for (int32_t c = fim; c != inicio; c -= deslocamento[direcao[c]]) passos++;
+    if (reservaCaminho(caminho, passos) == -1) return -1;
+
+    size_t k = passos;
+    for (int32_t c = fim; c != inicio; c -= deslocamento[direcao[c]]) {
+        caminho->passos[--k] = direcao[c];
+    }
+    caminho->tamanho = passos;
+    return 0;
+}
+
+// Saídas usadas pela heurística, já em coordenadas
+typedef struct {
+    int x[SAIDAS_HEURISTICA], y[SAIDAS_HEURISTICA];
+    int n; // 0: heurística nula
+} Alvos;
+
+static void preparaAlvos(const Labirinto *lab, Alvos *alvos) {
+    alvos->n = lab->num_saidas <= SAIDAS_HEURISTICA ? (int)lab->num_saidas : 0;
+    for (int k = 0; k < alvos->n; k++) {
+        alvos->x[k] = lab->saidas[k] / lab->colunas;
+        alvos->y[k] = lab->saidas[k] % lab->colunas;
+    }
+}
+
+// Distância de Manhattan até a saída mais próxima: nunca superestima e muda no máximo 1 por
+// passo, então a primeira vez que uma saída sai da fila o caminho é mínimo
+static inline int32_t estimativa(const Alvos *alvos, int x, int y) {
+    int32_t menor = alvos->n ? INT32_MAX : 0;
+    for (int k = 0; k < alvos->n; k++) {
+        int32_t d = abs(x - alvos->x[k]) + abs(y - alvos->y[k]);
+        if (d < menor) menor = d;
+    }
+    return menor;
+}
+
+// A* com fila de baldes. Com custo 1 por passo e a heurística de Manhattan, o f = custo +
+// estimativa de um vizinho é f ou f + 2 (f + 1 com a heurística nula), então bastam dois
+// baldes: o de f atual, que cresce do início de `fila`, e o seguinte, que cresce do fim.
+// Entradas de células que melhoraram depois de entrar no balde seguinte são descartadas ao
+// sair; cada célula entra no máximo uma vez em cada balde
+static int buscaAEstrela(const Labirinto *lab, int start_x, int start_y, AreaBusca *area, Caminho *caminho) {
+    size_t total = (size_t)lab->linhas * lab->colunas;
+    caminho->tamanho = 0;
+    if (reservaAreaBusca(area, total, true) == -1) return -1;
+
+    uint8_t *direcao = area->direcao;
+    int32_t *baldes = area->fila, *custo = area->custo;
+    memset(direcao, 0, total);
+
+    Alvos alvos;
+    preparaAlvos(lab, &alvos);
+    for (int k = 1; k < alvos.n; k++) {
+        // Saídas de paridades (x + y) diferentes deixariam f + 1 acontecer: heurística nula
+        if ((alvos.x[k] + alvos.y[k] + alvos.x[0] + alvos.y[0]) % 2 != 0) alvos.n = 0;
+    }
+    int32_t colunas = lab->colunas;
+    int32_t deslocamento[5] = {0, -colunas, 1, colunas, -1};
+    int32_t salto = alvos.n ? 2 : 1;
+    int32_t inicio = (int32_t)((size_t)start_x * colunas + start_y);
+    direcao[inicio] = ORIGEM;
+    custo[inicio] = 0;
+
+    size_t baixo = 0, alto = 2 * total; // Baldes: [0, baixo) e [alto, 2 * total)
+    bool atual_embaixo = true;
+    int32_t f = estimativa(&alvos, start_x, start_y), fim = -1;
+    baldes[baixo++] = inicio;
+    uint64_t expandidos = 0;
+
+    while (1) {
+        if (atual_embaixo ? baixo == 0 : alto == 2 * total) {
+            if (atual_embaixo ? alto == 2 * total : baixo == 0) break; // Nada mais alcançável
+            atual_embaixo = !atual_embaixo;
+            f += salto;
+            continue;
+        }
+        int32_t current = atual_embaixo ? baldes[--baixo] : baldes[alto++];
+        int pos[2] = {current / colunas, current % colunas};
+        if (custo[current] + estimativa(&alvos, pos[0], pos[1]) != f) continue; // Entrada antiga
+        expandidos++;
+        if (tipoIndice(lab, current) == EXIT) {
+            fim = current;
+            break;
+        }
+
+        uint8_t livres = movimentosValidos(lab, pos);
+        int32_t g = custo[current] + 1;
+        for (int d = 1; d <= 4; d++) {
+            if (!(livres & (1 << (d - 1)))) continue;
+            int32_t proximo = current + deslocamento[d];
+            if (direcao[proximo] != 0 && custo[proximo] <= g) continue;
+            direcao[proximo] = (uint8_t)d;
+            custo[proximo] = g;
+            int32_t fv = g + estimativa(&alvos, pos[0] + (d == 3) - (d == 1), pos[1] + (d == 2) - (d == 4));
+            // No mesmo balde (mesmo f) a célula vai para o topo: busca em profundidade nos empates
+            if ((fv == f) == atual_embaixo) baldes[baixo++] = proximo;
+            else baldes[--alto] = proximo;
+        }
+    }
+
+    area->expandidos = expandidos;
+    if (fim == -1) return 0;
+
+    size_t passos = (size_t)custo[fim];
+    if (reservaCaminho(caminho, passos) == -1) return -1;
+    size_t k = passos;
+    for (int32_t c = fim; c != inicio; c -= deslocamento[direcao[c]]) {
+        caminho->passos[--k] = direcao[c];
+    }
+    caminho->tamanho = passos;
+    return 0;
+}
+
+// BFS a partir da posição e, ao mesmo tempo, de todas as saídas, uma camada inteira por vez
+// do lado com a fronteira menor. A primeira aresta entre as duas buscas fecha um caminho
+// mínimo: cada lado já esgotou as distâncias menores que a da sua fronteira
+static int buscaBidirecional(const Labirinto *lab, int start_x, int start_y, AreaBusca *area, Caminho *caminho) {
+    size_t total = (size_t)lab->linhas * lab->colunas;
+    caminho->tamanho = 0;
+    if (reservaAreaBusca(area, total, false) == -1) return -1;
+
+    uint8_t *direcao = area->direcao;
+    memset(direcao, 0, total);
+
+    int32_t colunas = lab->colunas;
+    int32_t deslocamento[5] = {0, -colunas, 1, colunas, -1};
+    int32_t inicio = (int32_t)((size_t)start_x * colunas + start_y);
+    area->expandidos = 0;
+    if (tipoIndice(lab, inicio) == EXIT || lab->num_saidas == 0) return 0;
+
+    int32_t *filas[2] = {area->fila, area->fila + total}; // 0: a partir da posição, 1: das saídas
+    size_t frente[2] = {0, 0}, fundo[2] = {0, 0};
+    filas[0][fundo[0]++] = inicio;
+    direcao[inicio] = ORIGEM;
+    for (size_t k = 0; k < lab->num_saidas; k++) {
+        direcao[lab->saidas[k]] = VOLTA | CHEGADA;
+        filas[1][fundo[1]++] = lab->saidas[k];
+    }
+
+    int32_t ida = -1, volta = -1; // Vizinhos onde as buscas se tocam
+    int meio = 0;                 // Direção de `ida` para `volta`
+    uint64_t expandidos = 0;
+    while (ida == -1 && frente[0] < fundo[0] && frente[1] < fundo[1]) {
+        int lado = fundo[0] - frente[0] <= fundo[1] - frente[1] ? 0 : 1;
+        int32_t *fila = filas[lado];
+        size_t fim_camada = fundo[lado];
+        while (ida == -1 && frente[lado] < fim_camada) {
+            int32_t current = fila[frente[lado]++];
+            expandidos++;
+            int pos[2] = {current / colunas, current % colunas};
+            uint8_t livres = movimentosValidos(lab, pos);
+            for (int d = 1; d <= 4; d++) {
+                if (!(livres & (1 << (d - 1)))) continue;
+                int32_t proximo = current + deslocamento[d];
+                if (direcao[proximo] == 0) {
+                    direcao[proximo] = lado == 0 ? (uint8_t)d : (uint8_t)(VOLTA | oposta[d]);
+                    fila[fundo[lado]++] = proximo;
+                } else if (((direcao[proximo] & VOLTA) != 0) != lado) {
+                    ida = lado == 0 ? current : proximo;
+                    volta = lado == 0 ? proximo : current;
+                    meio = lado == 0 ? d : oposta[d];
+                    break;
+                }
+            }
+        }
+    }
+
+    area->expandidos = expandidos;
+    if (ida == -1) return 0;
+
+    size_t ate_meio = 0, depois = 0;
+    for (int32_t c = ida; c != inicio; c -= deslocamento[direcao[c]]) ate_meio++;
+    for (int32_t c = volta; (direcao[c] & 7) != CHEGADA; c += deslocamento[direcao[c] & 7]) depois++;
+    size_t passos = ate_meio + 1 + depois;
+    if (reservaCaminho(caminho, passos) == -1) return -1;
+
+    size_t k = ate_meio;
+    for (int32_t c = ida; c != inicio; c -= deslocamento[direcao[c]]) {
+        caminho->passos[--k] = direcao[c];
+    }
+    k = ate_meio;
+    caminho->passos[k++] = (uint8_t)meio;
+    for (int32_t c = volta; (direcao[c] & 7) != CHEGADA; c += deslocamento[direcao[c] & 7]) {
+        caminho->passos[k++] = direcao[c] & 7;
+    }
+    caminho->tamanho = passos;
+    return 0;
+}
+
+// Jump point search em 4 direções. Entre os caminhos mínimos, só os que fazem os passos
+// verticais o mais cedo possível são considerados: andando na horizontal só se vira para cima
+// ou para baixo onde a célula anterior tinha parede desse lado (vizinho forçado). Assim uma
+// reta horizontal só para em saídas e vizinhos forçados, e uma vertical para onde uma reta
+// horizontal a partir dela pararia. Só esses pontos de salto entram no heap
+
+static inline bool horizontal(int d) {
+    return d == 2 || d == 4;
+}
+
+// Próximo ponto de salto a partir de (x, y) na direção d, ou -1
+static int32_t salta(const Labirinto *lab, int x, int y, int d) {
+    int dx = (d == 3) - (d == 1), dy = (d == 2) - (d == 4);
+    int32_t c = (int32_t)((size_t)x * lab->colunas + y), passo = dx * lab->colunas + dy;
+    while (celulaLivre(lab, x + dx, y + dy)) {
+        x += dx;
+        y += dy;
+        c += passo;
+        if (tipoIndice(lab, c) == EXIT) return c;
+        if (dy != 0) {
+            if ((celulaLivre(lab, x - 1, y) && !celulaLivre(lab, x - 1, y - dy))
+                || (celulaLivre(lab, x + 1, y) && !celulaLivre(lab, x + 1, y - dy))) {
+                return c;
+            }
+        } else if (salta(lab, x, y, 2) != -1 || salta(lab, x, y, 4) != -1) {
+            return c;
+        }
+    }
+    return -1;
+}
+
+// Heap binário mínimo de (f << 32 | célula) guardado em `fila`, que tem espaço para
+// `capacidade` entradas de 64 bits
+static void sobeHeap(uint64_t *heap, size_t i) {
+    uint64_t v = heap[i];
+    while (i > 0 && heap[(i - 1) / 2] > v) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i] = v;
+}
+
+static uint64_t tiraHeap(uint64_t *heap, size_t *n) {
+    uint64_t topo = heap[0], v = heap[--*n];
+    size_t i = 0;
+    while (2 * i + 1 < *n) {
+        size_t f = 2 * i + 1;
+        if (f + 1 < *n && heap[f + 1] < heap[f]) f++;
+        if (heap[f] >= v) break;
+        heap[i] = heap[f];
+        i = f;
+    }
+    heap[i] = v;
+    return topo;
+}
+
+static int buscaSaltos(const Labirinto *lab, int start_x, int start_y, AreaBusca *area, Caminho *caminho) {
+    size_t total = (size_t)lab->linhas * lab->colunas;
+    caminho->tamanho = 0;
+    if (reservaAreaBusca(area, total, true) == -1) return -1;
+
+    uint8_t *direcao = area->direcao;
+    int32_t *custo = area->custo;
+    uint64_t *heap = (uint64_t *)area->fila;
+    size_t n = 0;
+    memset(direcao, 0, total);
+
+    Alvos alvos;
+    preparaAlvos(lab, &alvos);
+    int32_t colunas = lab->colunas;
+    int32_t deslocamento[5] = {0, -colunas, 1, colunas, -1};
+    int32_t inicio = (int32_t)((size_t)start_x * colunas + start_y);
+    direcao[inicio] = ORIGEM;
+    custo[inicio] = 0;
+    heap[n++] = (uint64_t)estimativa(&alvos, start_x, start_y) << 32 | (uint32_t)inicio;
+    int32_t fim = -1;
+    uint64_t expandidos = 0;
+
+    while (n > 0) {
+        int32_t current = (int32_t)(uint32_t)tiraHeap(heap, &n);
+        if (direcao[current] & FECHADA) continue; // Entrada antiga
+        expandidos++;
+        if (tipoIndice(lab, current) == EXIT) {
+            fim = current;
+            break;
+        }
+        int chegada = direcao[current];
+        direcao[current] |= FECHADA;
+
+        int x = current / colunas, y = current % colunas;
+        for (int d = 1; d <= 4; d++) {
+            // Da origem e depois de um passo vertical, todas as direções menos a de volta;
+            // depois de um horizontal, a mesma ou a de um vizinho forçado
+            if (chegada != ORIGEM && d == oposta[chegada]) continue;
+            if (chegada != ORIGEM && horizontal(chegada) && d != chegada) {
+                int trasy = y - (chegada == 2 ? 1 : -1);
+                int lado = d == 1 ? x - 1 : x + 1;
+                if (!celulaLivre(lab, lado, y) || celulaLivre(lab, lado, trasy)) continue;
+            }
+            int32_t ponto = salta(lab, x, y, d);
+            if (ponto == -1) continue;
+            int32_t g = custo[current] + abs(ponto / colunas - x) + abs(ponto % colunas - y);
+            if (direcao[ponto] != 0 && ((direcao[ponto] & FECHADA) || custo[ponto] <= g)) continue;
+            if (n == total) {
+                // Heap cheio (nunca visto na prática): a BFS responde com a mesma área
+                return buscaCaminho(lab, start_x, start_y, area, caminho);
+            }
+            direcao[ponto] = (uint8_t)d;
+            custo[ponto] = g;
+            heap[n] = (uint64_t)(g + estimativa(&alvos, ponto / colunas, ponto % colunas)) << 32 | (uint32_t)ponto;
+            sobeHeap(heap, n++);
+        }
+    }
+
+    area->expandidos = expandidos;
+    if (fim == -1) return 0;
+
+    // Volta reta a reta: de cada ponto anda-se para trás até uma célula marcada cujo custo
+    // seja o do ponto menos os passos dados, que é um ponto de salto de um caminho mínimo
+    size_t passos = (size_t)custo[fim];
+    if (reservaCaminho(caminho, passos) == -1) return -1;
+    size_t k = passos;
+    int32_t c = fim;
+    while (c != inicio) {
+        int d = direcao[c] & 7;
+        int32_t alvo = custo[c];
+        do {
+            caminho->passos[--k] = (uint8_t)d;
+            c -= deslocamento[d];
+            alvo--;
+        } while (c != inicio && !(direcao[c] && custo[c] == alvo));
+    }
+    caminho->tamanho = passos;
+    return 0;
+}
+
+int buscaComMotor(int motor, const Labirinto *lab, int start_x, int start_y, AreaBusca *area, Caminho *caminho) {
+    switch (motor) {
+        case MOTOR_TABELA:
+            if (lab->proximo) {
+                area->expandidos = 0;
+                return caminhoPorDistancias(lab, start_x, start_y, caminho);
+            }
+            return buscaCaminho(lab, start_x, start_y, area, caminho);
+        case MOTOR_ASTAR:
+            return buscaAEstrela(lab, start_x, start_y, area, caminho);
+        case MOTOR_BIDIRECIONAL:
+            return buscaBidirecional(lab, start_x, start_y, area, caminho);
+        case MOTOR_JPS:
+            return buscaSaltos(lab, start_x, start_y, area, caminho);
+        default:
+            return buscaCaminho(lab, start_x, start_y, area, caminho);
+    }
+}
+
+// Dica sem busca: segue a tabela `proximo` da posição atual até a saída. Um caminho mínimo
+// tem menos passos que células; chegar a esse limite é uma tabela com ciclo
+int caminhoPorDistancias(const Labirinto *lab, int start_x, int start_y, Caminho *caminho) {
+    int32_t colunas = lab->colunas;
+    int32_t deslocamento[5] = {0, -colunas, 1, colunas, -1};
+    int32_t c = (int32_t)((size_t)start_x * colunas + start_y);
+    size_t limite = (size_t)lab->linhas * colunas;
+    caminho->tamanho = 0;
+
+    while (lab->proximo[c] >= 1 && lab->proximo[c] <= 4) {
+        if (caminho->tamanho == limite) {
+            caminho->tamanho = 0;
+            return -1;
+        }
+        // Nunca além do limite: quem já passa essa capacidade (a arena da sessão) não é realocado
+        if (caminho->tamanho == caminho->capacidade) {
+            size_t capacidade = caminho->capacidade ? caminho->capacidade * 2 : 64;
+            if (reservaCaminho(caminho, capacidade < limite ? capacidade : limite) == -1) return -1;
+        }
+        caminho->passos[caminho->tamanho++] = lab->proximo[c];
+        c += deslocamento[lab->proximo[c]];
+    }
+    return 0;
+}
+
+void liberaAreaBusca(AreaBusca *area) {
+    free(area->direcao);
+    free(area->fila);
+    free(area->custo);
+    area->direcao = NULL;
+    area->fila = NULL;
+    area->custo = NULL;
+    area->capacidade = 0;
+}
+
+void liberaCaminho(Caminho *caminho) {
+    free(caminho->passos);
+    caminho->passos = NULL;
+    caminho->tamanho = caminho->capacidade = 0;
+}
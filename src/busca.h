@@ -0,0 +1,55 @@
+#ifndef BUSCA_H
+#define BUSCA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "labirinto.h"
+
+// Motores de busca da dica: todos devolvem um caminho mínimo até a saída mais próxima
+// (custo 1 por passo), diferindo em quantas células visitam para achá-lo
+#define MOTOR_TABELA 0       // Segue Labirinto.proximo, sem busca (BFS se não houver tabela)
+#define MOTOR_BFS 1
+#define MOTOR_ASTAR 2        // A* com distância de Manhattan até a saída mais próxima
+#define MOTOR_BIDIRECIONAL 3 // BFS da posição e de todas as saídas até as fronteiras se tocarem
+#define MOTOR_JPS 4          // Jump point search em 4 direções, para áreas abertas
+#define NUM_MOTORES 5
+
+// A* e JPS usam a heurística só até este número de saídas; acima disso ela vale 0
+#define SAIDAS_HEURISTICA 8
+
+// Caminho como sequência de direções (1 cima, 2 direita, 3 baixo, 4 esquerda)
+typedef struct {
+    uint8_t *passos;
+    size_t tamanho;
+    size_t capacidade;
+} Caminho;
+
+// Memória de rascunho da busca, reaproveitada entre dicas da mesma sessão
+typedef struct {
+    uint8_t *direcao; // Direção usada para chegar a cada célula, 0 se não visitada
+    int32_t *fila;    // filasMotor(motor) * capacidade posições
+    int32_t *custo;   // Passos desde a origem de cada célula visitada (A* e JPS)
+    size_t capacidade; // Em células
+    uint64_t expandidos; // Células tiradas da fila na última busca
+} AreaBusca;
+
+// Nome usado na linha de comando, ou -1 se desconhecido
+int motorPorNome(const char *nome);
+const char *nomeMotor(int motor);
+// Posições de AreaBusca.fila por célula que o motor usa (0 para a tabela) e se usa `custo`
+size_t filasMotor(int motor);
+bool usaCusto(int motor);
+
+// Retorna -1 se faltar memória; caminho->tamanho fica 0 se não houver saída alcançável.
+// A área é aumentada com realloc se a capacidade não bastar
+int buscaComMotor(int motor, const Labirinto *lab, int start_x, int start_y, AreaBusca *area, Caminho *caminho);
+int buscaCaminho(const Labirinto *lab, int start_x, int start_y, AreaBusca *area, Caminho *caminho);
+// Retorna -1 também se a tabela `proximo` tiver ciclo; com capacidade de linhas * colunas
+// passos o caminho nunca é realocado
+int caminhoPorDistancias(const Labirinto *lab, int start_x, int start_y, Caminho *caminho);
+void liberaCaminho(Caminho *caminho);
+void liberaAreaBusca(AreaBusca *area);
+
+#endif
@@ -0,0 +1,431 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include "protocolo.h"
+
+// Gerador de carga: abre muitas sessões simultâneas, mantém até `profundidade` pedidos em
+// andamento por sessão (pipeline) e mede a latência de cada tipo de ação.
+// Com -r as sessões jogam juntas na sala dada, e -e acrescenta espectadores que só recebem
+// os quadros da sala.
+// Uso: carga <endereco> <porta> [-c conexoes] [-d segundos] [-p profundidade]
+//            [-m start=1,move=70,batch=5,map=10,hint=10,reset=4] [-r sala] [-e espectadores] [-j]
+
+#define MAX_EVENTOS 512
+#define MAX_PROFUNDIDADE 64
+#define BUFFER_RESPOSTA 65536
+
+// Tipos de ação medidos
+enum { T_START, T_MOVE, T_BATCH, T_MAP, T_HINT, T_RESET, T_JOIN, NUM_TIPOS };
+static const char *nomes_tipos[NUM_TIPOS] = {"start", "move", "batch", "map", "hint", "reset", "join"};
+
+// Histograma log-linear: 16 sub-faixas por potência de 2, em nanossegundos
+#define SUBFAIXAS 16
+#define FAIXAS 40
+
+typedef struct {
+    uint64_t contagem[FAIXAS * SUBFAIXAS];
+    uint64_t total;
+    uint64_t maximo;
+    uint64_t bytes;
+} Histograma;
+
+static int faixaHistograma(uint64_t ns) {
+    if (ns < SUBFAIXAS) return (int)ns;
+    int bits = 63 - __builtin_clzll(ns);  // ns >= 16, então bits >= 4
+    int faixa = bits - 3;                   // Faixas 1.. cobrem [2^bits, 2^(bits+1))
+    int sub = (int)((ns >> (bits - 4)) & (SUBFAIXAS - 1));
+    int indice = faixa * SUBFAIXAS + sub;
+    return indice < FAIXAS * SUBFAIXAS ? indice : FAIXAS * SUBFAIXAS - 1;
+}
+
+// Limite superior da faixa, usado para relatar percentis
+static uint64_t valorFaixa(int indice) {
+    int faixa = indice / SUBFAIXAS, sub = indice % SUBFAIXAS;
+    if (faixa == 0) return (uint64_t)sub;
+    int bits = faixa + 3;
+    return ((uint64_t)(SUBFAIXAS + sub + 1)) << (bits - 4);
+}
+
+static void registraHistograma(Histograma *h, uint64_t ns) {
+    h->contagem[faixaHistograma(ns)]++;
+    h->total++;
+    if (ns > h->maximo) h->maximo = ns;
+}
+
+static uint64_t percentil(const Histograma *h, double p) {
+    if (h->total == 0) return 0;
+    uint64_t alvo = (uint64_t)(p * h->total);
+    if (alvo >= h->total) alvo = h->total - 1;
+    uint64_t acumulado = 0;
+    for (int i = 0; i < FAIXAS * SUBFAIXAS; i++) {
+        acumulado += h->contagem[i];
+        if (acumulado > alvo) {
+            uint64_t v = valorFaixa(i);
+            return v < h->maximo ? v : h->maximo;
+        }
+    }
+    return h->maximo;
+}
+
+typedef struct {
+    int socket;
+    int conectado;
+    int espectador;
+    // Pedidos em andamento, na ordem de envio (as respostas chegam na mesma ordem)
+    uint8_t tipos[MAX_PROFUNDIDADE];
+    uint64_t enviados_em[MAX_PROFUNDIDADE];
+    int inicio, pendentes;
+    uint8_t *resposta;
+    size_t recebidos;
+} Conexao;
+
+static uint64_t agoraNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint64_t estado = 0x2545F4914F6CDD1Dull;
+
+static uint32_t aleatorio(void) {
+    estado ^= estado << 13;
+    estado ^= estado >> 7;
+    estado ^= estado << 17;
+    return (uint32_t)(estado >> 32);
+}
+
+static int pesos[NUM_TIPOS] = {1, 70, 5, 10, 10, 4, 0};
+static int peso_total;
+static int profundidade = 8;
+static Histograma histogramas[NUM_TIPOS];
+static uint64_t erros;
+static uint32_t sala;      // 0: cada sessão joga sozinha
+static uint64_t quadros_sala[2], bytes_sala[2]; // ACTION_ROOM_DELTA recebidos por jogadores [0] e espectadores [1]
+
+static int sorteiaTipo(void) {
+    int r = (int)(aleatorio() % peso_total);
+    for (int t = 0; t < NUM_TIPOS; t++) {
+        if (r < pesos[t]) return t;
+        r -= pesos[t];
+    }
+    return T_MOVE;
+}
+
+// Monta o pedido do tipo dado em `quadro` e retorna o tamanho
+static size_t montaPedido(int tipo, uint8_t *quadro, int espectador) {
+    switch (tipo) {
+        case T_JOIN:
+            escreveCabecalho(quadro, ACTION_JOIN, ENTRADA_SALA);
+            escreveU32(quadro + CABECALHO_TAMANHO, sala);
+            quadro[CABECALHO_TAMANHO + 4] = espectador ? SALA_ESPECTADOR : SALA_JOGADOR;
+            return CABECALHO_TAMANHO + ENTRADA_SALA;
+        case T_START:
+            escreveCabecalho(quadro, ACTION_START, 0);
+            return CABECALHO_TAMANHO;
+        case T_MOVE:
+            escreveCabecalho(quadro, ACTION_MOVE, 1);
+            quadro[CABECALHO_TAMANHO] = (uint8_t)(aleatorio() % 4 + 1);
+            return CABECALHO_TAMANHO + 1;
+        case T_BATCH: {
+            uint16_t n = 16;
+            escreveCabecalho(quadro, ACTION_MOVE_BATCH, 2 + tamanhoDirecoes(n));
+            escreveU16(quadro + CABECALHO_TAMANHO, n);
+            for (uint16_t i = 0; i < n; i++) empacotaDirecao(quadro + CABECALHO_TAMANHO + 2, i, aleatorio() % 4 + 1);
+            return CABECALHO_TAMANHO + 2 + tamanhoDirecoes(n);
+        }
+        case T_MAP:
+            escreveCabecalho(quadro, ACTION_MAP, 1);
+            quadro[CABECALHO_TAMANHO] = MAPA_INCREMENTAL;
+            return CABECALHO_TAMANHO + 1;
+        case T_HINT:
+            escreveCabecalho(quadro, ACTION_HINT, 0);
+            return CABECALHO_TAMANHO;
+        default:
+            escreveCabecalho(quadro, ACTION_RESET, 0);
+            return CABECALHO_TAMANHO;
+    }
+}
+
+// Completa o pipeline da conexão; o primeiro pedido de cada sessão é sempre START (ou JOIN
+// com sala). Espectadores só enviam o JOIN
+static int enviaPedidos(Conexao *c, int primeiro) {
+    uint8_t lote[MAX_PROFUNDIDADE * 16];
+    size_t usado = 0;
+    uint64_t agora = agoraNs();
+    while (c->pendentes < profundidade && (primeiro || !c->espectador)) {
+        int tipo = primeiro ? (sala ? T_JOIN : T_START) : sorteiaTipo();
+        primeiro = 0;
+        usado += montaPedido(tipo, lote + usado, c->espectador);
+        int fim = (c->inicio + c->pendentes) % MAX_PROFUNDIDADE;
+        c->tipos[fim] = (uint8_t)tipo;
+        c->enviados_em[fim] = agora;
+        c->pendentes++;
+    }
+    if (usado == 0) return 0;
+
+    // Pedidos pequenos: um send curto só acontece com o buffer do socket cheio, o que
+    // significa que o servidor parou de ler
+    ssize_t n = send(c->socket, lote, usado, MSG_NOSIGNAL);
+    return n == (ssize_t)usado ? 0 : -1;
+}
+
+// Consome as respostas completas e registra a latência de cada uma
+static int trataRespostas(Conexao *c) {
+    while (1) {
+        ssize_t n = recv(c->socket, c->resposta + c->recebidos, BUFFER_RESPOSTA - c->recebidos, 0);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        c->recebidos += n;
+
+        uint64_t agora = agoraNs();
+        size_t inicio = 0;
+        while (c->recebidos - inicio >= CABECALHO_TAMANHO) {
+            uint32_t tamanho = leU32(c->resposta + inicio + 2);
+            if (CABECALHO_TAMANHO + tamanho > BUFFER_RESPOSTA) return -1; // Mapa grande demais para o teste
+            if (c->recebidos - inicio < CABECALHO_TAMANHO + tamanho) break;
+            uint8_t opcode = c->resposta[inicio + 1];
+            inicio += CABECALHO_TAMANHO + tamanho;
+
+            // Quadros da sala chegam sem pedido
+            if (opcode == ACTION_ROOM_DELTA) {
+                quadros_sala[c->espectador]++;
+                bytes_sala[c->espectador] += CABECALHO_TAMANHO + tamanho;
+                continue;
+            }
+
+            if (c->pendentes == 0) return -1; // Resposta sem pedido
+            int tipo = c->tipos[c->inicio];
+            registraHistograma(&histogramas[tipo], agora - c->enviados_em[c->inicio]);
+            histogramas[tipo].bytes += CABECALHO_TAMANHO + tamanho;
+            c->inicio = (c->inicio + 1) % MAX_PROFUNDIDADE;
+            c->pendentes--;
+        }
+        memmove(c->resposta, c->resposta + inicio, c->recebidos - inicio);
+        c->recebidos -= inicio;
+    }
+    return enviaPedidos(c, 0);
+}
+
+static int resolveEndereco(const char *host, const char *porta, struct sockaddr_storage *addr, socklen_t *len) {
+    struct addrinfo hints = {0}, *res;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, porta, &hints, &res) != 0) return -1;
+    memcpy(addr, res->ai_addr, res->ai_addrlen);
+    *len = res->ai_addrlen;
+    freeaddrinfo(res);
+    return 0;
+}
+
+static void leMistura(const char *texto) {
+    char copia[256];
+    snprintf(copia, sizeof(copia), "%s", texto);
+    memset(pesos, 0, sizeof(pesos));
+    for (char *item = strtok(copia, ","); item; item = strtok(NULL, ",")) {
+        char *igual = strchr(item, '=');
+        if (!igual) continue;
+        *igual = '\0';
+        for (int t = 0; t < NUM_TIPOS; t++) {
+            if (strcmp(item, nomes_tipos[t]) == 0) pesos[t] = atoi(igual + 1);
+        }
+    }
+}
+
+static void aumentaLimiteArquivos(void) {
+    struct rlimit limite;
+    if (getrlimit(RLIMIT_NOFILE, &limite) == 0) {
+        limite.rlim_cur = limite.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limite);
+    }
+}
+
+static void relatorio(int json, int conexoes, double conexoes_s, double segundos) {
+    uint64_t total = 0;
+    for (int t = 0; t < NUM_TIPOS; t++) total += histogramas[t].total;
+
+    if (json) {
+        printf("{\"conexoes\":%d,\"conexoes_por_s\":%.0f,\"segundos\":%.3f,\"pedidos\":%llu,\"pedidos_por_s\":%.0f,"
+               "\"erros\":%llu,\"quadros_sala\":%llu,\"quadros_sala_espectadores\":%llu,\"bytes_sala_espectadores\":%llu,"
+               "\"acoes\":{", conexoes, conexoes_s, segundos, (unsigned long long)total, total / segundos,
+               (unsigned long long)erros, (unsigned long long)quadros_sala[0], (unsigned long long)quadros_sala[1],
+               (unsigned long long)bytes_sala[1]);
+        int primeiro = 1;
+        for (int t = 0; t < NUM_TIPOS; t++) {
+            const Histograma *h = &histogramas[t];
+            if (h->total == 0) continue;
+            printf("%s\"%s\":{\"pedidos\":%llu,\"por_s\":%.0f,\"bytes\":%llu,\"p50_us\":%.1f,\"p99_us\":%.1f,"
+                   "\"p999_us\":%.1f,\"max_us\":%.1f}", primeiro ? "" : ",", nomes_tipos[t],
+                   (unsigned long long)h->total, h->total / segundos, (unsigned long long)h->bytes,
+                   percentil(h, 0.50) / 1e3, percentil(h, 0.99) / 1e3, percentil(h, 0.999) / 1e3, h->maximo / 1e3);
+            primeiro = 0;
+        }
+        printf("}}\n");
+        return;
+    }
+
+    printf("%d conexões (%.0f conexões/s), %.1f s, %llu pedidos (%.0f/s), %llu erros\n", conexoes, conexoes_s,
+           segundos, (unsigned long long)total, total / segundos, (unsigned long long)erros);
+    printf("%-6s %10s %10s %10s %10s %10s %10s\n", "acao", "pedidos", "por_s", "p50_us", "p99_us", "p999_us", "max_us");
+    for (int t = 0; t < NUM_TIPOS; t++) {
+        const Histograma *h = &histogramas[t];
+        if (h->total == 0) continue;
+        printf("%-6s %10llu %10.0f %10.1f %10.1f %10.1f %10.1f\n", nomes_tipos[t], (unsigned long long)h->total,
+               h->total / segundos, percentil(h, 0.50) / 1e3, percentil(h, 0.99) / 1e3, percentil(h, 0.999) / 1e3,
+               h->maximo / 1e3);
+    }
+    if (sala) {
+        printf("sala %u: %llu quadros para jogadores, %llu para espectadores (%.0f/s, %.1f MB/s)\n", sala,
+               (unsigned long long)quadros_sala[0], (unsigned long long)quadros_sala[1], quadros_sala[1] / segundos,
+               bytes_sala[1] / segundos / 1e6);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "Uso: %s <endereco> <porta> [-c conexoes] [-d segundos] [-p profundidade] [-m mistura]\n"
+                        "          [-r sala] [-e espectadores] [-j]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    int num_conexoes = 100;
+    int num_espectadores = 0;
+    double duracao = 5;
+    int json = 0;
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) num_conexoes = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) duracao = atof(argv[++i]);
+        else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) profundidade = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) leMistura(argv[++i]);
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) sala = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) num_espectadores = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-j") == 0) json = 1;
+        else {
+            fprintf(stderr, "Opção inválida: %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    for (int t = 0; t < NUM_TIPOS; t++) peso_total += pesos[t];
+    if (num_conexoes < 1 || profundidade < 1 || profundidade > MAX_PROFUNDIDADE || peso_total <= 0 ||
+        num_espectadores < 0 || (num_espectadores > 0 && sala == 0)) {
+        fprintf(stderr, "Parâmetros inválidos\n");
+        return EXIT_FAILURE;
+    }
+
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    if (resolveEndereco(argv[1], argv[2], &addr, &addr_len) == -1) {
+        fprintf(stderr, "Erro ao resolver endereço\n");
+        return EXIT_FAILURE;
+    }
+    aumentaLimiteArquivos();
+
+    int epoll_fd = epoll_create1(0);
+    num_conexoes += num_espectadores; // Espectadores ficam no fim
+    Conexao *conexoes = calloc(num_conexoes, sizeof(Conexao));
+    if (epoll_fd == -1 || !conexoes) {
+        perror("Erro ao iniciar");
+        return EXIT_FAILURE;
+    }
+
+    // Fase 1: abrir todas as conexões e medir a taxa de estabelecimento
+    uint64_t inicio_conexao = agoraNs();
+    int abertas = 0;
+    for (int i = 0; i < num_conexoes; i++) {
+        Conexao *c = &conexoes[i];
+        c->espectador = i >= num_conexoes - num_espectadores;
+        c->socket = socket(addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        c->resposta = malloc(BUFFER_RESPOSTA);
+        if (c->socket == -1 || !c->resposta) {
+            perror("Erro ao criar conexão");
+            return EXIT_FAILURE;
+        }
+        int flag = 1;
+        setsockopt(c->socket, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+        if (connect(c->socket, (struct sockaddr *)&addr, addr_len) == -1 && errno != EINPROGRESS) {
+            perror("Erro ao conectar");
+            return EXIT_FAILURE;
+        }
+        struct epoll_event ev = {.events = EPOLLOUT | EPOLLIN, .data.ptr = c};
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, c->socket, &ev);
+    }
+
+    struct epoll_event eventos[MAX_EVENTOS];
+    uint64_t fim_conexao = 0, fim_teste = 0, inicio_teste = 0;
+    while (1) {
+        uint64_t agora = agoraNs();
+        if (fim_teste && agora >= fim_teste) break;
+        int n = epoll_wait(epoll_fd, eventos, MAX_EVENTOS, 100);
+        if (n == -1 && errno != EINTR) {
+            perror("Erro no epoll_wait");
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            Conexao *c = eventos[i].data.ptr;
+            if (c->socket == -1) continue;
+            int falhou = 0;
+            if (!c->conectado) {
+                int erro = 0;
+                socklen_t len = sizeof(erro);
+                getsockopt(c->socket, SOL_SOCKET, SO_ERROR, &erro, &len);
+                if (erro != 0) {
+                    falhou = 1;
+                } else {
+                    c->conectado = 1;
+                    abertas++;
+                    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = c};
+                    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c->socket, &ev);
+                    // Fase 2 começa quando todas estão abertas; até lá só o START é enviado
+                    if (fim_teste) falhou = enviaPedidos(c, 1) == -1;
+                }
+            } else if (trataRespostas(c) == -1) {
+                falhou = 1;
+            }
+
+            if (falhou) {
+                erros++;
+                close(c->socket);
+                c->socket = -1;
+                if (c->conectado) abertas--;
+            }
+        }
+
+        if (!fim_teste && abertas + (int)erros >= num_conexoes) {
+            fim_conexao = agoraNs();
+            inicio_teste = fim_conexao;
+            fim_teste = inicio_teste + (uint64_t)(duracao * 1e9);
+            for (int i = 0; i < num_conexoes; i++) {
+                Conexao *c = &conexoes[i];
+                if (c->socket != -1 && c->conectado && enviaPedidos(c, 1) == -1) {
+                    erros++;
+                    close(c->socket);
+                    c->socket = -1;
+                }
+            }
+        }
+    }
+
+    double segundos_conexao = (fim_conexao - inicio_conexao) / 1e9;
+    double segundos = (agoraNs() - inicio_teste) / 1e9;
+    relatorio(json, abertas, segundos_conexao > 0 ? abertas / segundos_conexao : 0, segundos);
+
+    for (int i = 0; i < num_conexoes; i++) {
+        if (conexoes[i].socket != -1) close(conexoes[i].socket);
+        free(conexoes[i].resposta);
+    }
+    free(conexoes);
+    close(epoll_fd);
+    return erros > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
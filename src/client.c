@@ -2,21 +2,13 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
 #include <arpa/inet.h>
 #include <netdb.h>
 
+#include "protocolo.h"
+
 #define BUFFER_SIZE 1024 // Tamanho do buffer para mensagens
-#define TAMANHO_LABIRINTO 10 // Tamanho máximo do labirinto
-
-// Tipos de ações
-#define ACTION_START 0
-#define ACTION_MOVE 1
-#define ACTION_MAP 2
-#define ACTION_HINT 3
-#define ACTION_UPDATE 4
-#define ACTION_WIN 5
-#define ACTION_RESET 6
-#define ACTION_EXIT 7
 
 // Representação do labirinto
 #define WALL '#'
@@ -26,22 +18,21 @@
 #define UNKNOWN '?'
 #define PLAYER '+'
 
-// Estrutura da mensagem
-struct action {
-    int type;
-    int moves[100];
-    int board[TAMANHO_LABIRINTO][TAMANHO_LABIRINTO];
-};
+// Valores das células no protocolo
+#define UNKNOWN_CELULA 4
+#define PLAYER_CELULA 5
 
-void mostrarDica(int moves[100]) {
+void mostrarDica(const uint8_t *carga, uint32_t tamanho) {
     printf("Hint: ");
     int first = 1;
+    uint32_t passos = tamanho >= 4 ? leU32(carga) : 0;
+    if (tamanhoDirecoes(passos) > tamanho - 4) passos = 0; // Carga truncada
 
-    for (int i = 0; i < 100 && moves[i] != 0; i++) {
+    for (uint32_t i = 0; i < passos; i++) {
         if (!first) printf(", ");
         first = 0;
 
-        switch (moves[i]) {
+        switch (desempacotaDirecao(carga + 4, i)) {
             case 1: printf("up"); break;
             case 2: printf("right"); break;
             case 3: printf("down"); break;
@@ -51,15 +42,16 @@ void mostrarDica(int moves[100]) {
     printf("\n");
 }
 
-void mostrarMovimentos(int moves[100]) {
+void mostrarMovimentos(uint8_t mascara) {
     printf("Possible moves: ");
     int first = 1;
 
-    for (int i = 0; i < 100 && moves[i] != 0; i++) {
+    for (int move = 1; move <= 4; move++) {
+        if (!(mascara & MOVIMENTO_BIT(move))) continue;
         if (!first) printf(", ");
         first = 0;
 
-        switch (moves[i]) {
+        switch (move) {
             case 1: printf("up"); break;
             case 2: printf("right"); break;
             case 3: printf("down"); break;
@@ -69,36 +61,245 @@ void mostrarMovimentos(int moves[100]) {
     printf(".\n");
 }
 
-void mostrarMapa(int board[TAMANHO_LABIRINTO][TAMANHO_LABIRINTO]) {
+char simboloCelula(int valor) {
+    switch (valor) {
+        case 0: return WALL;
+        case 1: return PATH;
+        case 2: return ENTRY;
+        case 3: return EXIT;
+        case 4: return UNKNOWN;
+        case 5: return PLAYER;
+        default: return '?'; // Caso inesperado
+    }
+}
+
+void mostrarMapa(const uint8_t *carga, uint32_t tamanho) {
+    if (tamanho < 4) return;
+    int linhas = leU16(carga), colunas = leU16(carga + 2);
+    if (tamanhoTabuleiro(linhas, colunas) > tamanho) return; // Carga truncada
+
     printf("Mapa do labirinto:\n");
-    for (int i = 0; i < TAMANHO_LABIRINTO; i++) {
-        for (int j = 0; j < TAMANHO_LABIRINTO; j++) {
-            char symbol;
-            switch (board[i][j]) {
-                case 0: symbol = WALL; break;
-                case 1: symbol = PATH; break;
-                case 2: symbol = ENTRY; break;
-                case 3: symbol = EXIT; break;
-                case 4: symbol = UNKNOWN; break;
-                case 5: symbol = PLAYER; break;
-                default: symbol = '?'; // Caso inesperado
-            }
-            printf("%c\t", symbol);
+    for (int i = 0; i < linhas; i++) {
+        for (int j = 0; j < colunas; j++) {
+            printf("%c\t", simboloCelula(desempacotaCelula(carga + 4, (size_t)i * colunas + j)));
         }
         printf("\n");
     }
 }
 
+#define SALA_MOSTRADOS 20 // Jogadores listados ao entrar em uma sala
+
+void mostrarSala(const uint8_t *carga, uint32_t tamanho) {
+    if (tamanho < SALA_CABECALHO) {
+        printf("Not in a room.\n");
+        return;
+    }
+    uint16_t id = leU16(carga + 8), n = leU16(carga + 10);
+    if ((size_t)SALA_CABECALHO + (size_t)n * SALA_JOGADOR_TAMANHO > tamanho) return; // Carga truncada
+    printf("Room %u (%dx%d), ", leU32(carga), leU16(carga + 4), leU16(carga + 6));
+    if (id == SALA_SEM_ID) printf("spectating");
+    else printf("you are player %d", id);
+    printf(", %d player(s)", n);
+    const uint8_t *p = carga + SALA_CABECALHO;
+    for (uint16_t k = 0; k < n && k < SALA_MOSTRADOS; k++, p += SALA_JOGADOR_TAMANHO) {
+        printf("%s %d at (%d, %d)", k ? "," : ":", leU16(p), leU16(p + 2), leU16(p + 4));
+    }
+    printf("%s\n", n > SALA_MOSTRADOS ? ", ..." : "");
+}
+
+void mostrarDeltaSala(const uint8_t *carga, uint32_t tamanho) {
+    if (tamanho < SALA_DELTA_CABECALHO) return;
+    uint16_t n = leU16(carga + 4);
+    if ((size_t)SALA_DELTA_CABECALHO + (size_t)n * SALA_JOGADOR_TAMANHO > tamanho) return;
+    const uint8_t *p = carga + SALA_DELTA_CABECALHO;
+    for (uint16_t k = 0; k < n; k++, p += SALA_JOGADOR_TAMANHO) {
+        if (leU16(p + 2) == SALA_SEM_ID) printf("[room %u] player %d left\n", leU32(carga), leU16(p));
+        else printf("[room %u] player %d at (%d, %d)\n", leU32(carga), leU16(p), leU16(p + 2), leU16(p + 4));
+    }
+}
+
+// Tudo o que o cliente já viu do labirinto, atualizado pelos quadros ACTION_MAP_DELTA
+typedef struct {
+    int linhas, colunas;
+    int jogador[2];
+    uint8_t *celulas; // Uma célula por byte, UNKNOWN até ser revelada
+} MapaLocal;
+
+// Incorpora as células novas ao mapa local. Retorna 0 se a carga for inválida
+int atualizaMapaLocal(MapaLocal *mapa, const uint8_t *carga, uint32_t tamanho) {
+    if (tamanho < DELTA_CABECALHO) return 0;
+    int linhas = leU16(carga), colunas = leU16(carga + 2);
+    uint16_t novas = leU16(carga + 8);
+    if ((size_t)DELTA_CABECALHO + (size_t)novas * DELTA_CELULA > tamanho) return 0;
+
+    if (!mapa->celulas || mapa->linhas != linhas || mapa->colunas != colunas) {
+        free(mapa->celulas);
+        mapa->celulas = malloc((size_t)linhas * colunas);
+        if (!mapa->celulas) return 0;
+        memset(mapa->celulas, UNKNOWN_CELULA, (size_t)linhas * colunas);
+        mapa->linhas = linhas;
+        mapa->colunas = colunas;
+    }
+    mapa->jogador[0] = leU16(carga + 4);
+    mapa->jogador[1] = leU16(carga + 6);
+
+    const uint8_t *p = carga + DELTA_CABECALHO;
+    for (uint16_t k = 0; k < novas; k++, p += DELTA_CELULA) {
+        int i = leU16(p), j = leU16(p + 2);
+        if (i < linhas && j < colunas) mapa->celulas[(size_t)i * colunas + j] = p[4];
+    }
+    return 1;
+}
+
+// Substitui o mapa local por um tabuleiro completo (ACTION_MAP), depois de retomar uma partida
+int carregaMapaLocal(MapaLocal *mapa, const uint8_t *carga, uint32_t tamanho) {
+    if (tamanho < 4) return 0;
+    int linhas = leU16(carga), colunas = leU16(carga + 2);
+    if (tamanhoTabuleiro(linhas, colunas) > tamanho) return 0;
+    free(mapa->celulas);
+    mapa->celulas = malloc((size_t)linhas * colunas);
+    if (!mapa->celulas) return 0;
+    mapa->linhas = linhas;
+    mapa->colunas = colunas;
+    for (size_t c = 0; c < (size_t)linhas * colunas; c++) {
+        int valor = desempacotaCelula(carga + 4, c);
+        if (valor == PLAYER_CELULA) {
+            mapa->jogador[0] = (int)(c / colunas);
+            mapa->jogador[1] = (int)(c % colunas);
+            valor = 1; // Sob o jogador sempre há caminho
+        }
+        mapa->celulas[c] = (uint8_t)valor;
+    }
+    return 1;
+}
+
+void mostrarMapaLocal(const MapaLocal *mapa) {
+    printf("Mapa do labirinto:\n");
+    for (int i = 0; i < mapa->linhas; i++) {
+        for (int j = 0; j < mapa->colunas; j++) {
+            int valor = (i == mapa->jogador[0] && j == mapa->jogador[1]) ? PLAYER_CELULA : mapa->celulas[(size_t)i * mapa->colunas + j];
+            printf("%c\t", simboloCelula(valor));
+        }
+        printf("\n");
+    }
+}
+
+// Envia exatamente `tamanho` bytes, repetindo enquanto o kernel aceitar só uma parte.
+// Retorna 0 se a conexão falhou
+int enviaTudo(int socket, const void *buffer, size_t tamanho) {
+    size_t enviados = 0;
+    while (enviados < tamanho) {
+        ssize_t n = send(socket, (const uint8_t *)buffer + enviados, tamanho - enviados, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        enviados += n;
+    }
+    return 1;
+}
+
+// `move` é a carga de um byte (direção ou modo do mapa); 0 envia carga vazia
 void enviaAction(int socket, int action_type, int move) {
-    struct action client_action = {0};
-    client_action.type = action_type;
-    if (move > 0) client_action.moves[0] = move;
+    uint8_t quadro[CABECALHO_TAMANHO + 1];
+    size_t tamanho = move > 0 ? 1 : 0;
+    escreveCabecalho(quadro, action_type, tamanho);
+    quadro[CABECALHO_TAMANHO] = (uint8_t)move;
+
+    if (!enviaTudo(socket, quadro, CABECALHO_TAMANHO + tamanho)) {
+        perror("Erro ao enviar dados");
+    }
+}
+
+// Início em um labirinto gerado pelo servidor a partir de lado e semente
+void enviaInicioGerado(int socket, int lado, uint64_t semente) {
+    uint8_t quadro[CABECALHO_TAMANHO + INICIO_GERADO];
+    escreveCabecalho(quadro, ACTION_START, INICIO_GERADO);
+    escreveU16(quadro + CABECALHO_TAMANHO, (uint16_t)lado);
+    escreveU64(quadro + CABECALHO_TAMANHO + 2, semente);
+    if (!enviaTudo(socket, quadro, sizeof(quadro))) {
+        perror("Erro ao enviar dados");
+    }
+}
+
+// Retoma a partida guardada sob o token
+void enviaRetomada(int socket, uint64_t token) {
+    uint8_t quadro[CABECALHO_TAMANHO + 8];
+    escreveCabecalho(quadro, ACTION_RESUME, 8);
+    escreveU64(quadro + CABECALHO_TAMANHO, token);
+    if (!enviaTudo(socket, quadro, sizeof(quadro))) {
+        perror("Erro ao enviar dados");
+    }
+}
 
-    if (send(socket, &client_action, sizeof(client_action), 0) == -1) {
+// Entra na sala como jogador ou espectador; lado e semente só valem se a sala for criada agora
+void enviaEntradaSala(int socket, uint32_t sala, int papel, int lado, uint64_t semente) {
+    uint8_t quadro[CABECALHO_TAMANHO + ENTRADA_SALA + INICIO_GERADO];
+    size_t tamanho = lado > 0 ? ENTRADA_SALA + INICIO_GERADO : ENTRADA_SALA;
+    escreveCabecalho(quadro, ACTION_JOIN, tamanho);
+    escreveU32(quadro + CABECALHO_TAMANHO, sala);
+    quadro[CABECALHO_TAMANHO + 4] = (uint8_t)papel;
+    escreveU16(quadro + CABECALHO_TAMANHO + ENTRADA_SALA, (uint16_t)lado);
+    escreveU64(quadro + CABECALHO_TAMANHO + ENTRADA_SALA + 2, semente);
+    if (!enviaTudo(socket, quadro, CABECALHO_TAMANHO + tamanho)) {
         perror("Erro ao enviar dados");
     }
 }
 
+// Envia uma sequência de direções ("up right down ...") em um único pedido.
+// Retorna 0 se alguma palavra não for uma direção
+int enviaLote(int socket, char *direcoes) {
+    uint8_t quadro[CABECALHO_TAMANHO + MAX_CARGA_PEDIDO] = {0};
+    uint16_t n = 0;
+    for (char *palavra = strtok(direcoes, " "); palavra; palavra = strtok(NULL, " ")) {
+        int move = 0;
+        if (strcmp(palavra, "up") == 0) move = 1;
+        else if (strcmp(palavra, "right") == 0) move = 2;
+        else if (strcmp(palavra, "down") == 0) move = 3;
+        else if (strcmp(palavra, "left") == 0) move = 4;
+        if (move == 0 || n == MAX_PASSOS_LOTE) return 0;
+        empacotaDirecao(quadro + CABECALHO_TAMANHO + 2, n++, move);
+    }
+
+    size_t tamanho = 2 + tamanhoDirecoes(n);
+    escreveCabecalho(quadro, ACTION_MOVE_BATCH, tamanho);
+    escreveU16(quadro + CABECALHO_TAMANHO, n);
+    if (!enviaTudo(socket, quadro, CABECALHO_TAMANHO + tamanho)) {
+        perror("Erro ao enviar dados");
+    }
+    return 1;
+}
+
+// Recebe exatamente `tamanho` bytes. Retorna 0 se a conexão foi encerrada
+int recebeTudo(int socket, void *buffer, size_t tamanho) {
+    size_t recebidos = 0;
+    while (recebidos < tamanho) {
+        ssize_t n = recv(socket, (uint8_t *)buffer + recebidos, tamanho - recebidos, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        recebidos += n;
+    }
+    return 1;
+}
+
+// Recebe um quadro completo; a carga é alocada e deve ser liberada pelo chamador
+int recebeQuadro(int socket, uint8_t *opcode, uint8_t **carga, uint32_t *tamanho) {
+    uint8_t cabecalho[CABECALHO_TAMANHO];
+    if (!recebeTudo(socket, cabecalho, sizeof(cabecalho))) return 0;
+    if (cabecalho[0] != PROTOCOLO_VERSAO) {
+        fprintf(stderr, "Versão de protocolo inesperada: %d\n", cabecalho[0]);
+        return 0;
+    }
+
+    *opcode = cabecalho[1];
+    *tamanho = leU32(cabecalho + 2);
+    *carga = malloc(*tamanho ? *tamanho : 1);
+    if (!*carga) return 0;
+    if (!recebeTudo(socket, *carga, *tamanho)) {
+        free(*carga);
+        return 0;
+    }
+    return 1;
+}
+
 void configuraCliente(const char *server_ip, int port, struct sockaddr_storage *server_addr, socklen_t *addr_len) {
     struct addrinfo hints, *res;
     memset(&hints, 0, sizeof(hints));
@@ -130,13 +331,8 @@ void configuraCliente(const char *server_ip, int port, struct sockaddr_storage *
     freeaddrinfo(res);
 }
 
-int movimentosValidos(int move, int valid_moves[100]) {
-    for (int i = 0; i < 100 && valid_moves[i] != 0; i++) {
-        if (valid_moves[i] == move) {
-            return 1;
-        }
-    }
-    return 0;
+int movimentosValidos(int move, uint8_t valid_moves) {
+    return (valid_moves & MOVIMENTO_BIT(move)) != 0;
 }
 
 int main(int argc, char *argv[]) {
@@ -171,10 +367,12 @@ int main(int argc, char *argv[]) {
 
     printf("Conectado ao servidor\n");
 
-    struct action server_response;
     char input[BUFFER_SIZE];
     int game_started = 0; // Variável de controle para verificar se o jogo foi iniciado
-    int valid_moves[100] = {0}; // Armazenar movimentos válidos
+    uint8_t valid_moves = 0; // Armazenar movimentos válidos
+    MapaLocal mapa = {0};
+    int sincronizar = 0; // Depois de retomar, o próximo mapa vem completo
+    int assistindo = 0;  // Espectador: só mostra o que a sala envia
 
     // Loop principal
     while (1) {
@@ -182,18 +380,55 @@ int main(int argc, char *argv[]) {
         fgets(input, sizeof(input), stdin);
         input[strcspn(input, "\n")] = 0; // Remover o newline
 
-        if (strcmp(input, "start") == 0) {
+        int lado;
+        unsigned long long semente;
+        unsigned sala;
+        int campos = sscanf(input, "join %u %d %llu", &sala, &lado, &semente);
+        if (campos >= 1) {
+            enviaEntradaSala(client_socket, sala, SALA_JOGADOR, campos == 3 ? lado : 0, campos == 3 ? semente : 0);
+            game_started = 1;
+            valid_moves = 0x0F; // O servidor corrige na primeira resposta de movimento
+            free(mapa.celulas);
+            mapa.celulas = NULL;
+        } else if (sscanf(input, "spectate %u", &sala) == 1) {
+            enviaEntradaSala(client_socket, sala, SALA_ESPECTADOR, 0, 0);
+            assistindo = 1;
+        } else if (strcmp(input, "leave") == 0) {
+            enviaEntradaSala(client_socket, 0, SALA_JOGADOR, 0, 0);
+        } else if (strcmp(input, "start") == 0) {
             enviaAction(client_socket, ACTION_START, 0);
             game_started = 1; // Marcar que o jogo foi iniciado
+            free(mapa.celulas); // O labirinto pode ter mudado
+            mapa.celulas = NULL;
+        } else if (sscanf(input, "start %d %llu", &lado, &semente) == 2) {
+            enviaInicioGerado(client_socket, lado, semente);
+            game_started = 1;
+            free(mapa.celulas);
+            mapa.celulas = NULL;
+        } else if (sscanf(input, "resume %llx", &semente) == 1) {
+            enviaRetomada(client_socket, semente);
+            free(mapa.celulas);
+            mapa.celulas = NULL;
         } else if (!game_started) {
             printf("error: start the game first\n");
             continue;
+        } else if (strncmp(input, "go ", 3) == 0) {
+            char direcoes[BUFFER_SIZE];
+            strcpy(direcoes, input + 3);
+            if (!enviaLote(client_socket, direcoes)) {
+                printf("error: command not found\n");
+                continue;
+            }
         } else if (strcmp(input, "map") == 0) {
-            enviaAction(client_socket, ACTION_MAP, 0);
+            enviaAction(client_socket, ACTION_MAP, sincronizar ? MAPA_COMPLETO : MAPA_INCREMENTAL);
+        } else if (strcmp(input, "token") == 0) {
+            enviaAction(client_socket, ACTION_TOKEN, 0);
         } else if (strcmp(input, "hint") == 0) {
             enviaAction(client_socket, ACTION_HINT, 0);
         } else if (strcmp(input, "reset") == 0) {
             enviaAction(client_socket, ACTION_RESET, 0);
+            free(mapa.celulas); // O servidor também esquece as células reveladas
+            mapa.celulas = NULL;
         } else if (strcmp(input, "exit") == 0) {
             enviaAction(client_socket, ACTION_EXIT, 0);
             break;
@@ -217,39 +452,100 @@ int main(int argc, char *argv[]) {
             }
         }
 
-        // Receber resposta do servidor
-        ssize_t bytes_received = recv(client_socket, &server_response, sizeof(server_response), 0);
-        if (bytes_received <= 0) {
+        // Receber resposta do servidor; as novidades da sala podem chegar antes dela
+        uint8_t opcode;
+        uint8_t *carga;
+        uint32_t tamanho;
+        int conectado;
+        while ((conectado = recebeQuadro(client_socket, &opcode, &carga, &tamanho)) && opcode == ACTION_ROOM_DELTA) {
+            mostrarDeltaSala(carga, tamanho);
+            free(carga);
+        }
+        if (!conectado) {
             printf("Conexão com o servidor encerrada\n");
             break;
         }
 
         // Processar resposta
-        switch (server_response.type) {
+        switch (opcode) {
             case ACTION_UPDATE:
-                if(strcmp(input, "map") == 0){
-                    mostrarMapa(server_response.board);
+                if (tamanho >= 1) {
+                    valid_moves = carga[0]; // Atualizar movimentos válidos
+                    mostrarMovimentos(valid_moves);
                 }
-                else if(strcmp(input, "hint") == 0){
-                    mostrarDica(server_response.moves);
+                break;
+
+            case ACTION_MAP:
+                if (sincronizar && carregaMapaLocal(&mapa, carga, tamanho)) {
+                    sincronizar = 0;
+                    mostrarMapaLocal(&mapa);
+                } else {
+                    mostrarMapa(carga, tamanho);
                 }
-                else{
-                    mostrarMovimentos(server_response.moves);
-                    memcpy(valid_moves, server_response.moves, sizeof(valid_moves)); // Atualizar movimentos válidos
+                break;
+
+            case ACTION_TOKEN:
+                if (tamanho >= 8) printf("Token: %016llx\n", (unsigned long long)leU64(carga));
+                break;
+
+            case ACTION_RESUME:
+                if (tamanho >= RETOMADA_TAMANHO && carga[0]) {
+                    printf("Resumed at (%d, %d) after %u move(s).\n", leU16(carga + 5), leU16(carga + 7), leU32(carga + 9));
+                    game_started = 1;
+                    sincronizar = 1;
+                    valid_moves = carga[13];
+                    mostrarMovimentos(valid_moves);
+                } else {
+                    printf("error: unknown token\n");
                 }
                 break;
 
+            case ACTION_MOVED:
+                if (tamanho >= MOVIDO_TAMANHO) {
+                    printf("Moved %d step(s).\n", leU16(carga));
+                    valid_moves = carga[6];
+                    if (carga[7]) printf("You escaped!\n");
+                    else mostrarMovimentos(valid_moves);
+                }
+                break;
+
+            case ACTION_MAP_DELTA:
+                if (atualizaMapaLocal(&mapa, carga, tamanho)) {
+                    mostrarMapaLocal(&mapa);
+                }
+                break;
+
+            case ACTION_HINT:
+                mostrarDica(carga, tamanho);
+                break;
+
+            case ACTION_ROOM:
+                mostrarSala(carga, tamanho);
+                // Não entrou: o servidor manteve a partida e as reveladas, o mapa local foi descartado
+                if (tamanho < SALA_CABECALHO) sincronizar = 1;
+                break;
+
             case ACTION_WIN:
                 printf("You escaped!\n");
-                mostrarMapa(server_response.board);
+                mostrarMapa(carga, tamanho);
                 break;
 
             default:
-                continue;
+                break;
         }
-
+        free(carga);
+
+        // Espectador acompanha a sala até a conexão fechar (Ctrl-C para sair)
+        while (assistindo && recebeQuadro(client_socket, &opcode, &carga, &tamanho)) {
+            if (opcode == ACTION_ROOM_DELTA) mostrarDeltaSala(carga, tamanho);
+            else if (opcode == ACTION_ROOM) mostrarSala(carga, tamanho);
+            fflush(stdout);
+            free(carga);
+        }
+        if (assistindo) break;
     }
 
+    free(mapa.celulas);
     close(client_socket);
     return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -0,0 +1,40 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "labirinto.h"
+
+// Converte um labirinto em texto (como input/in.txt) para o formato binário que o
+// servidor mapeia direto na memória, já com a tabela de distâncias calculada.
+// Uso: compilador <labirinto.txt> <saida.lab>
+
+static double agora(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        fprintf(stderr, "Uso: %s <labirinto.txt> <saida.lab>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    double inicio = agora();
+    Labirinto lab;
+    if (carregaLabirinto(argv[1], &lab) == -1) {
+        return EXIT_FAILURE;
+    }
+    double carregado = agora();
+
+    if (salvaLabirintoBinario(&lab, argv[2]) == -1) {
+        perror("Erro ao gravar o labirinto binário");
+        liberaLabirinto(&lab);
+        return EXIT_FAILURE;
+    }
+
+    printf("%s: %dx%d, entrada (%d,%d), carga %.1f ms, gravação %.1f ms\n", argv[2], lab.linhas, lab.colunas,
+           lab.entrada[0], lab.entrada[1], (carregado - inicio) * 1e3, (agora() - carregado) * 1e3);
+    liberaLabirinto(&lab);
+    return EXIT_SUCCESS;
+}
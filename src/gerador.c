@@ -0,0 +1,278 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "gerador.h"
+
+// splitmix64 espalha sementes próximas (0, 1, 2...) antes do xorshift
+static uint64_t misturaSemente(uint64_t semente) {
+    uint64_t z = semente + 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    z ^= z >> 31;
+    return z ? z : 1; // xorshift não sai do zero
+}
+
+static inline uint64_t aleatorio(uint64_t *estado) {
+    *estado ^= *estado << 13;
+    *estado ^= *estado >> 7;
+    *estado ^= *estado << 17;
+    return *estado;
+}
+
+int ladoGerado(int lado) {
+    if (lado < LADO_MINIMO) lado = LADO_MINIMO;
+    if (lado > LADO_MAXIMO) lado = LADO_MAXIMO;
+    return lado | 1;
+}
+
+// Backtracking iterativo sobre as células de coordenadas ímpares: a pilha guarda o caminho
+// atual e cada passo abre a parede entre a célula do topo e um vizinho ainda não visitado
+int geraLabirinto(Labirinto *lab, int lado, uint64_t semente) {
+    lado = ladoGerado(lado);
+    uint8_t *celulas = calloc((size_t)lado * lado, 1); // Tudo WALL
+    int32_t *pilha = malloc(((size_t)lado / 2) * (lado / 2) * sizeof(int32_t));
+    if (!celulas || !pilha) {
+        free(celulas);
+        free(pilha);
+        return -1;
+    }
+
+    uint64_t estado = misturaSemente(semente);
+    size_t topo = 0;
+    pilha[topo++] = lado + 1;
+    celulas[lado + 1] = PATH;
+    int32_t salto[4] = {-2 * lado, 2, 2 * lado, -2};
+
+    while (topo > 0) {
+        int32_t atual = pilha[topo - 1];
+        int x = atual / lado, y = atual % lado;
+        int opcoes[4], n = 0;
+        if (x > 1 && celulas[atual + salto[0]] == WALL) opcoes[n++] = 0;
+        if (y < lado - 2 && celulas[atual + salto[1]] == WALL) opcoes[n++] = 1;
+        if (x < lado - 2 && celulas[atual + salto[2]] == WALL) opcoes[n++] = 2;
+        if (y > 1 && celulas[atual + salto[3]] == WALL) opcoes[n++] = 3;
+        if (n == 0) {
+            topo--;
+            continue;
+        }
+        int d = n == 1 ? opcoes[0] : opcoes[aleatorio(&estado) % n];
+        celulas[atual + salto[d] / 2] = PATH;
+        celulas[atual + salto[d]] = PATH;
+        pilha[topo++] = atual + salto[d];
+    }
+    free(pilha);
+
+    celulas[lado + 1] = ENTRY;
+    celulas[(size_t)(lado - 2) * lado + lado - 2] = EXIT;
+    int resultado = montaLabirinto(lab, lado, lado, celulas);
+    free(celulas);
+    return resultado;
+}
+
+#define ENTRADA_GERANDO 0
+#define ENTRADA_PRONTA 1
+#define ENTRADA_FALHOU 2
+#define RESERVA_NOVA_NS (1000ull * 1000 * 1000) // Quem espera pergunta de novo a cada tique
+
+// O Labirinto é o primeiro campo, então o ponteiro entregue às sessões é o da entrada
+typedef struct EntradaCache {
+    Labirinto lab;
+    int lado;
+    uint64_t semente;
+    int referencias; // A fila de geração segura uma enquanto a entrada não fica pronta
+    int estado;
+    size_t bytes;    // Estimativa reservada no limite de bytes
+    uint64_t pronta_em; // Quem pediu ainda não pegou a sua referência; não sai logo em seguida
+    struct EntradaCache *anterior, *seguinte; // Lista LRU: a cabeça é a mais recente
+    struct EntradaCache *proxima_fila;
+} EntradaCache;
+
+// Poucas entradas (cada uma pode ter dezenas de MB), então a busca é linear na lista
+static pthread_mutex_t trava_cache = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t fila_cheia = PTHREAD_COND_INITIALIZER;
+static EntradaCache *cabeca, *cauda;
+static EntradaCache *fila_inicio, *fila_fim; // Entradas esperando a thread de geração
+static size_t quantidade, bytes_cache;
+static size_t capacidade_cache = 16;
+static int lado_permitido = LADO_MAXIMO;
+static size_t bytes_permitidos = SIZE_MAX;
+
+void configuraCacheLabirintos(size_t capacidade) {
+    capacidade_cache = capacidade;
+}
+
+void configuraLimitesGerados(int lado_maximo, size_t bytes_maximo) {
+    lado_permitido = lado_maximo;
+    bytes_permitidos = bytes_maximo;
+}
+
+// Planos de tipos (nibbles), de livres (bits, com a borda) e da tabela de distâncias (bytes)
+static size_t bytesGerado(int lado) {
+    return (size_t)lado * lado / 2 + (size_t)(lado + 2) * ((lado + 2 + 63) / 64) * 8 + (size_t)lado * lado;
+}
+
+static void removeDaLista(EntradaCache *e) {
+    if (e->anterior) e->anterior->seguinte = e->seguinte;
+    else cabeca = e->seguinte;
+    if (e->seguinte) e->seguinte->anterior = e->anterior;
+    else cauda = e->anterior;
+    e->anterior = e->seguinte = NULL;
+    quantidade--;
+    bytes_cache -= e->bytes;
+}
+
+static void insereNaCabeca(EntradaCache *e) {
+    e->anterior = NULL;
+    e->seguinte = cabeca;
+    if (cabeca) cabeca->anterior = e;
+    cabeca = e;
+    if (!cauda) cauda = e;
+    quantidade++;
+    bytes_cache += e->bytes;
+}
+
+static uint64_t relogioNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Tira do cache as entradas sem referências mais antigas até caber na capacidade e no
+// limite de bytes, menos as recém-geradas. Devolve a lista das removidas, que são liberadas
+// fora da trava
+static EntradaCache *excedentes(void) {
+    EntradaCache *removidas = NULL;
+    uint64_t agora = relogioNs();
+    for (EntradaCache *e = cauda; e && (quantidade > capacidade_cache || bytes_cache > bytes_permitidos);) {
+        EntradaCache *anterior = e->anterior;
+        if (e->referencias == 0 && agora - e->pronta_em >= RESERVA_NOVA_NS) {
+            removeDaLista(e);
+            e->seguinte = removidas;
+            removidas = e;
+        }
+        e = anterior;
+    }
+    return removidas;
+}
+
+static void liberaEntradas(EntradaCache *e) {
+    while (e) {
+        EntradaCache *seguinte = e->seguinte;
+        liberaLabirinto(&e->lab);
+        free(e);
+        e = seguinte;
+    }
+}
+
+static EntradaCache *procura(int lado, uint64_t semente) {
+    for (EntradaCache *e = cabeca; e; e = e->seguinte) {
+        if (e->lado == lado && e->semente == semente) return e;
+    }
+    return NULL;
+}
+
+const Labirinto *obtemLabirintoGerado(int lado, uint64_t semente) {
+    lado = ladoGerado(lado);
+    pthread_mutex_lock(&trava_cache);
+    EntradaCache *e = procura(lado, semente);
+    if (e && e->estado == ENTRADA_PRONTA) {
+        e->referencias++;
+        removeDaLista(e);
+        insereNaCabeca(e);
+    } else {
+        e = NULL;
+    }
+    pthread_mutex_unlock(&trava_cache);
+    return e ? &e->lab : NULL;
+}
+
+int preparaLabirintoGerado(int lado, uint64_t semente, const Labirinto **lab) {
+    lado = ladoGerado(lado);
+    if (lado > lado_permitido) return GERADO_RECUSADO;
+    EntradaCache *removidas = NULL;
+    int resultado;
+    pthread_mutex_lock(&trava_cache);
+    EntradaCache *e = procura(lado, semente);
+    if (e && e->estado == ENTRADA_FALHOU) {
+        // Quem pediu fica sabendo da falha; um pedido seguinte tenta de novo
+        removeDaLista(e);
+        e->seguinte = NULL;
+        removidas = e;
+        resultado = GERADO_RECUSADO;
+    } else if (e && e->estado == ENTRADA_GERANDO) {
+        resultado = GERADO_GERANDO;
+    } else if (e) {
+        e->referencias++;
+        removeDaLista(e);
+        insereNaCabeca(e);
+        *lab = &e->lab;
+        resultado = GERADO_PRONTO;
+    } else if (!(e = calloc(1, sizeof(EntradaCache)))) {
+        resultado = GERADO_RECUSADO;
+    } else {
+        // A entrada ocupa o limite desde já, para que muitas gerações ao mesmo tempo não o
+        // ultrapassem; sem espaço nem tirando as entradas livres, o pedido é recusado
+        e->lado = lado;
+        e->semente = semente;
+        e->bytes = bytesGerado(lado);
+        e->referencias = 1;
+        insereNaCabeca(e);
+        removidas = excedentes();
+        if (bytes_cache > bytes_permitidos) {
+            removeDaLista(e);
+            free(e);
+            resultado = GERADO_RECUSADO;
+        } else {
+            if (fila_fim) fila_fim->proxima_fila = e;
+            else fila_inicio = e;
+            fila_fim = e;
+            pthread_cond_signal(&fila_cheia);
+            resultado = GERADO_NOVO;
+        }
+    }
+    pthread_mutex_unlock(&trava_cache);
+    liberaEntradas(removidas);
+    return resultado;
+}
+
+// Gera uma entrada por vez, fora da trava, na ordem em que foram pedidas
+static void *loopGeracao(void *arg) {
+    (void)arg;
+    while (1) {
+        pthread_mutex_lock(&trava_cache);
+        while (!fila_inicio) pthread_cond_wait(&fila_cheia, &trava_cache);
+        EntradaCache *e = fila_inicio;
+        fila_inicio = e->proxima_fila;
+        if (!fila_inicio) fila_fim = NULL;
+        pthread_mutex_unlock(&trava_cache);
+
+        bool gerado = geraLabirinto(&e->lab, e->lado, e->semente) == 0;
+
+        pthread_mutex_lock(&trava_cache);
+        e->estado = gerado ? ENTRADA_PRONTA : ENTRADA_FALHOU;
+        e->pronta_em = relogioNs();
+        e->referencias--;
+        EntradaCache *removidas = excedentes();
+        pthread_mutex_unlock(&trava_cache);
+        liberaEntradas(removidas);
+    }
+    return NULL;
+}
+
+int iniciaGeracao(void) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, loopGeracao, NULL) != 0) return -1;
+    pthread_detach(thread);
+    return 0;
+}
+
+void devolveLabirintoGerado(const Labirinto *lab) {
+    EntradaCache *e = (EntradaCache *)lab;
+    pthread_mutex_lock(&trava_cache);
+    e->referencias--;
+    EntradaCache *removidas = e->referencias == 0 ? excedentes() : NULL;
+    pthread_mutex_unlock(&trava_cache);
+    liberaEntradas(removidas);
+}
@@ -0,0 +1,44 @@
+#ifndef GERADOR_H
+#define GERADOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "labirinto.h"
+
+// Labirintos perfeitos gerados a partir de (lado, semente): a mesma semente gera sempre o
+// mesmo labirinto, com a entrada em (1,1) e a saída no canto oposto.
+
+#define LADO_MINIMO 5
+#define LADO_MAXIMO 4095 // Coordenadas do protocolo são u16; 4095² células ocupam ~30 MB
+
+// Ajusta o lado pedido para um valor ímpar dentro dos limites
+int ladoGerado(int lado);
+
+// Gera e monta (com a tabela de distâncias) um labirinto. Retorna -1 sem memória
+int geraLabirinto(Labirinto *lab, int lado, uint64_t semente);
+
+// Cache LRU compartilhado entre os workers. Cada labirinto entregue tem uma referência que
+// deve ser devolvida; só labirintos sem referências saem do cache
+void configuraCacheLabirintos(size_t capacidade);
+// Limites do servidor: maior lado aceito e bytes de todos os labirintos do cache, em uso ou
+// na fila. Pedidos acima deles são recusados
+void configuraLimitesGerados(int lado_maximo, size_t bytes_maximo);
+// Cria a thread de geração; antes dos workers
+int iniciaGeracao(void);
+
+// Labirinto que já está pronto no cache, com uma referência a mais; NULL se não está. Quem
+// precisa de um labirinto novo chama preparaLabirintoGerado antes
+const Labirinto *obtemLabirintoGerado(int lado, uint64_t semente);
+void devolveLabirintoGerado(const Labirinto *lab);
+
+// Garante que o labirinto fica pronto no cache sem gerar na thread de quem chama: a geração
+// (com a tabela de distâncias, centenas de ms nos lados grandes) vai para a thread de geração
+#define GERADO_PRONTO 0   // No cache, e `*lab` tem uma referência
+#define GERADO_NOVO 1     // Entrou na fila agora; perguntar de novo depois
+#define GERADO_GERANDO 2  // Já estava na fila
+#define GERADO_RECUSADO 3 // Acima dos limites, ou a geração falhou por falta de memória
+int preparaLabirintoGerado(int lado, uint64_t semente, const Labirinto **lab);
+
+#endif
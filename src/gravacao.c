@@ -0,0 +1,167 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+
+#include "gravacao.h"
+#include "sessao.h"
+#include "metricas.h"
+
+#define GRAVACAO_INTERVALO_MS 10
+#define GRAVACAO_MAXIMO (64 * 1024 * 1024) // Buffer de um worker; acima disso registros são descartados
+
+_Thread_local Gravador *gravador_thread;
+
+static Gravador *gravadores[MAX_WORKERS];
+static _Atomic int num_gravadores;
+static _Atomic uint32_t ultima_sessao;
+static uint64_t inicio_gravacao;
+static int fd_gravacao = -1;
+
+void registraGravador(Gravador *gravador) {
+    int i = atomic_load(&num_gravadores);
+    if (i >= MAX_WORKERS) return;
+    pthread_mutex_init(&gravador->trava, NULL);
+    gravadores[i] = gravador;
+    atomic_store(&num_gravadores, i + 1);
+}
+
+static int escreveTudo(int fd, const uint8_t *dados, size_t tamanho) {
+    while (tamanho > 0) {
+        ssize_t n = write(fd, dados, tamanho);
+        if (n < 0) return -1;
+        dados += n;
+        tamanho -= n;
+    }
+    return 0;
+}
+
+// Troca o buffer de cada worker por um vazio e grava fora da trava
+static void *loopGravacao(void *arg) {
+    (void)arg;
+    struct timespec espera = {0, GRAVACAO_INTERVALO_MS * 1000 * 1000};
+    uint8_t *lote = NULL;
+    size_t capacidade_lote = 0;
+    while (1) {
+        nanosleep(&espera, NULL);
+        int n = atomic_load(&num_gravadores);
+        for (int w = 0; w < n; w++) {
+            Gravador *g = gravadores[w];
+            pthread_mutex_lock(&g->trava);
+            size_t tamanho = g->tamanho;
+            if (tamanho > 0) {
+                uint8_t *dados = g->dados;
+                size_t capacidade = g->capacidade;
+                g->dados = lote;
+                g->capacidade = capacidade_lote;
+                g->tamanho = 0;
+                lote = dados;
+                capacidade_lote = capacidade;
+            }
+            pthread_mutex_unlock(&g->trava);
+            if (tamanho > 0 && escreveTudo(fd_gravacao, lote, tamanho) == -1) perror("Erro ao gravar as sessões");
+        }
+    }
+    return NULL;
+}
+
+int iniciaGravacao(const char *arquivo) {
+    fd_gravacao = open(arquivo, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_gravacao == -1) return -1;
+    struct timespec parede;
+    clock_gettime(CLOCK_REALTIME, &parede);
+    uint8_t cabecalho[GRAVACAO_CABECALHO];
+    memcpy(cabecalho, MAGICA_GRAVACAO, 8);
+    escreveU64(cabecalho + 8, (uint64_t)parede.tv_sec * 1000000000ull + parede.tv_nsec);
+    if (escreveTudo(fd_gravacao, cabecalho, sizeof(cabecalho)) == -1) return -1;
+    inicio_gravacao = agoraNs();
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, loopGravacao, NULL) != 0) return -1;
+    pthread_detach(thread);
+    return 0;
+}
+
+// Espaço para `tamanho` bytes no fim do buffer do worker, com a trava tomada. NULL (e trava
+// liberada) se o buffer passaria do máximo ou faltou memória
+static uint8_t *reserva(Gravador *g, size_t tamanho) {
+    pthread_mutex_lock(&g->trava);
+    if (g->tamanho + tamanho > g->capacidade) {
+        size_t capacidade = g->capacidade ? g->capacidade : 64 * 1024;
+        while (capacidade < g->tamanho + tamanho) capacidade *= 2;
+        uint8_t *dados = capacidade <= GRAVACAO_MAXIMO ? realloc(g->dados, capacidade) : NULL;
+        if (!dados) {
+            pthread_mutex_unlock(&g->trava);
+            if (metricas_thread) somaContador(&metricas_thread->gravacao_descartados, 1);
+            return NULL;
+        }
+        g->dados = dados;
+        g->capacidade = capacidade;
+    }
+    uint8_t *p = g->dados + g->tamanho;
+    g->tamanho += tamanho;
+    return p;
+}
+
+static uint8_t *iniciaRegistro(Gravador *g, Sessao *sessao, uint8_t tipo, size_t corpo, uint64_t instante) {
+    uint8_t *p = reserva(g, 4 + corpo);
+    if (!p) return NULL;
+    escreveU32(p, (uint32_t)corpo);
+    p[4] = tipo;
+    escreveU32(p + 5, sessao->id_gravacao);
+    escreveU64(p + 9, instante - inicio_gravacao);
+    return p + 4 + REGISTRO_FIXO;
+}
+
+// Soma `n` bytes do anel a partir de `deslocamento`, em até dois trechos contíguos
+static uint64_t somaAnel(const Anel *anel, size_t deslocamento, size_t n, uint64_t soma) {
+    size_t pos = (anel->inicio + deslocamento) & (anel->capacidade - 1);
+    size_t primeiro = n < anel->capacidade - pos ? n : anel->capacidade - pos;
+    soma = somaBytes(soma, anel->dados + pos, primeiro);
+    return somaBytes(soma, anel->dados, n - primeiro);
+}
+
+void gravaPedido(Sessao *sessao, uint8_t opcode, const uint8_t *carga, uint32_t tamanho, size_t saida_antes, uint64_t instante) {
+    Gravador *g = gravador_thread;
+    if (!sessao->id_gravacao) sessao->id_gravacao = atomic_fetch_add(&ultima_sessao, 1) + 1;
+
+    // Resumo das respostas que este pedido acrescentou ao anel de saída
+    const Anel *saida = &sessao->saida;
+    uint64_t soma = SOMA_INICIAL, token = 0;
+    uint16_t quadros = 0;
+    size_t pos = saida_antes;
+    while (!saida->erro && pos + CABECALHO_TAMANHO <= saida->tamanho) {
+        uint8_t cabecalho[CABECALHO_TAMANHO];
+        anelCopia(saida, pos, cabecalho, sizeof(cabecalho));
+        uint32_t carga_resposta = leU32(cabecalho + 2);
+        soma = somaBytes(soma, cabecalho + 1, 1);
+        soma = somaAnel(saida, pos + CABECALHO_TAMANHO, cargaComparada(cabecalho[1], carga_resposta), soma);
+        if (cabecalho[1] == ACTION_TOKEN && carga_resposta == 8) {
+            uint8_t valor[8];
+            anelCopia(saida, pos + CABECALHO_TAMANHO, valor, sizeof(valor));
+            token = leU64(valor);
+        }
+        quadros++;
+        pos += CABECALHO_TAMANHO + carga_resposta;
+    }
+
+    uint8_t *p = iniciaRegistro(g, sessao, REGISTRO_PEDIDO, REGISTRO_FIXO + PEDIDO_FIXO + tamanho, instante);
+    if (!p) return;
+    p[0] = opcode;
+    escreveU16(p + 1, quadros);
+    escreveU32(p + 3, (uint32_t)(pos - saida_antes));
+    escreveU64(p + 7, soma);
+    escreveU64(p + 15, token);
+    memcpy(p + PEDIDO_FIXO, carga, tamanho);
+    pthread_mutex_unlock(&g->trava);
+}
+
+void gravaFechamento(Sessao *sessao) {
+    Gravador *g = gravador_thread;
+    if (!sessao->id_gravacao) return; // Nunca enviou um pedido
+    if (iniciaRegistro(g, sessao, REGISTRO_FECHA, REGISTRO_FIXO, agoraNs())) pthread_mutex_unlock(&g->trava);
+}
@@ -0,0 +1,68 @@
+#ifndef GRAVACAO_H
+#define GRAVACAO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include "protocolo.h"
+
+// Gravação das sessões (server -r) para reprodução com bin/replay. Cada pedido recebido vira
+// um registro com o instante, a carga e um resumo da resposta (quadros e soma), que o replay
+// compara com o que o servidor responder. Cada worker acumula registros no seu buffer e uma
+// thread própria os grava no arquivo, como o WAL: o worker nunca espera o disco.
+//
+// Arquivo: MAGICA_GRAVACAO, u64 relógio de parede do início (ns) e registros, todos com
+// inteiros big-endian: u32 tamanho do corpo e o corpo, que começa com u8 tipo, u32 sessão
+// (1, 2, ... na ordem do primeiro pedido) e u64 ns desde o início da gravação.
+// REGISTRO_PEDIDO continua com u8 opcode, u16 quadros e u32 bytes da resposta, u64 soma da
+// resposta, u64 token entregue nela (0 se nenhum) e a carga do pedido no resto do corpo.
+// REGISTRO_FECHA não tem mais nada. Registros de workers diferentes se intercalam no
+// arquivo, mas os de uma sessão estão sempre em ordem
+
+#define MAGICA_GRAVACAO "GRAVLAB1"
+#define GRAVACAO_CABECALHO 16
+#define REGISTRO_PEDIDO 1
+#define REGISTRO_FECHA 2
+#define REGISTRO_FIXO 13  // Tipo, sessão e instante
+#define PEDIDO_FIXO 23    // Opcode, quadros, bytes, soma e token
+
+// A soma de uma resposta cobre o opcode de cada quadro e a parte determinística da carga: o
+// token de ACTION_TOKEN é sorteado e os jogadores de ACTION_ROOM dependem da ordem de chegada
+// das outras sessões, então só a sala e as dimensões entram. ACTION_ROOM_DELTA não é resposta
+#define SOMA_INICIAL 14695981039346656037ull
+
+static inline uint64_t somaBytes(uint64_t soma, const uint8_t *p, size_t n) {
+    for (size_t i = 0; i < n; i++) soma = (soma ^ p[i]) * 1099511628211ull; // FNV-1a
+    return soma;
+}
+
+static inline size_t cargaComparada(uint8_t opcode, size_t tamanho) {
+    if (opcode == ACTION_TOKEN) return 0;
+    if (opcode == ACTION_ROOM) return tamanho < 8 ? tamanho : 8;
+    return tamanho;
+}
+
+typedef struct Sessao Sessao;
+
+// Registros de um worker esperando a thread de gravação
+typedef struct {
+    pthread_mutex_t trava;
+    uint8_t *dados;
+    size_t tamanho, capacidade;
+} Gravador;
+
+// Gravador do worker da thread atual (NULL sem -r)
+extern _Thread_local Gravador *gravador_thread;
+
+// Cria o arquivo e a thread de gravação
+int iniciaGravacao(const char *arquivo);
+// Antes das threads dos workers começarem
+void registraGravador(Gravador *gravador);
+
+// Chamado depois de processaAcao: a resposta é o que entrou no anel de saída a partir de
+// `saida_antes` bytes
+void gravaPedido(Sessao *sessao, uint8_t opcode, const uint8_t *carga, uint32_t tamanho, size_t saida_antes, uint64_t instante);
+void gravaFechamento(Sessao *sessao);
+
+#endif
@@ -0,0 +1,464 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "labirinto.h"
+
+// Formato binário pré-compilado (little-endian). O cabeçalho é seguido pelos planos
+// `tipos`, `livres` e `proximo`, cada um alinhado em 8 bytes e no mesmo layout usado em
+// memória, de forma que o arquivo é mapeado e usado sem conversão
+#define MAGICA_BINARIO "LABIRIN1"
+#define VERSAO_BINARIO 1
+
+typedef struct {
+    char magica[8];
+    uint32_t versao;
+    uint32_t linhas, colunas;
+    int32_t entrada[2];
+    uint32_t reservado;
+    uint64_t deslocamento_tipos;
+    uint64_t deslocamento_livres;
+    uint64_t deslocamento_proximo;
+    uint64_t tamanho; // Do arquivo inteiro
+    uint64_t soma;    // somaVerificacao de tudo o que vem depois do cabeçalho
+} CabecalhoBinario;
+
+_Static_assert(sizeof(CabecalhoBinario) == 72, "cabeçalho binário deve ter 72 bytes");
+
+static size_t alinha8(size_t n) {
+    return (n + 7) & ~(size_t)7;
+}
+
+// Tamanhos dos planos para as dimensões dadas
+static size_t bytesTipos(size_t linhas, size_t colunas) {
+    return (linhas * colunas + 1) / 2;
+}
+
+static size_t palavrasLinha(size_t colunas) {
+    return (colunas + 2 + 63) / 64;
+}
+
+// Uma palavra extra no fim para janelaLivre poder ler p[1] na última linha
+static size_t bytesLivres(size_t linhas, size_t colunas) {
+    return ((linhas + 2) * palavrasLinha(colunas) + 1) * sizeof(uint64_t);
+}
+
+// Mistura palavra a palavra; bem mais rápida que uma soma byte a byte em arquivos grandes
+static uint64_t somaVerificacao(const uint8_t *dados, size_t tamanho) {
+    uint64_t h = 0x9E3779B97F4A7C15ull ^ tamanho;
+    size_t k = 0;
+    for (; k + 8 <= tamanho; k += 8) {
+        uint64_t v;
+        memcpy(&v, dados + k, 8);
+        h = (h ^ v) * 0x100000001B3ull;
+        h ^= h >> 29;
+    }
+    for (; k < tamanho; k++) {
+        h = (h ^ dados[k]) * 0x100000001B3ull;
+    }
+    return h;
+}
+
+// Guarda os índices das células de saída, usados pelos motores de busca da dica
+static int listaSaidas(Labirinto *lab) {
+    size_t total = (size_t)lab->linhas * lab->colunas, n = 0;
+    for (size_t c = 0; c < total; c++) n += tipoIndice(lab, c) == EXIT;
+    lab->saidas = malloc((n ? n : 1) * sizeof(int32_t));
+    if (!lab->saidas) return -1;
+    lab->num_saidas = n;
+    n = 0;
+    for (size_t c = 0; c < total; c++) {
+        if (tipoIndice(lab, c) == EXIT) lab->saidas[n++] = (int32_t)c;
+    }
+    return 0;
+}
+
+// Formato texto: uma linha do labirinto por linha do arquivo, um dígito de 0 a 5 por célula,
+// separados ou não por espaços. Todas as linhas precisam ter o mesmo número de células
+static int carregaTexto(const char *filename, const char *texto, size_t tamanho, Labirinto *lab) {
+    // Primeira passada: validar e descobrir as dimensões
+    int linhas = 0, colunas = -1, j = 0, linha_arquivo = 1;
+    for (size_t k = 0; k <= tamanho; k++) {
+        char ch = k < tamanho ? texto[k] : '\n';
+        if (ch == '\n') {
+            if (j > 0) {
+                if (colunas != -1 && j != colunas) {
+                    fprintf(stderr, "%s:%d: linha com %d células, esperado %d\n", filename, linha_arquivo, j, colunas);
+                    return -1;
+                }
+                colunas = j;
+                linhas++;
+            }
+            j = 0; // Reiniciar a coluna para a nova linha
+            linha_arquivo++;
+        } else if (ch >= '0' && ch <= '5') {
+            j++;
+        } else if (ch != ' ' && ch != '\t' && ch != '\r') {
+            fprintf(stderr, "%s:%d: caractere inválido '%c'\n", filename, linha_arquivo, ch);
+            return -1;
+        }
+    }
+    // Índices de célula usam int32_t e o protocolo envia dimensões em u16
+    if (linhas == 0 || linhas > UINT16_MAX || colunas > UINT16_MAX || (int64_t)linhas * colunas > INT32_MAX) {
+        fprintf(stderr, "%s: dimensões inválidas: %dx%d\n", filename, linhas, colunas);
+        return -1;
+    }
+
+    uint8_t *celulas = malloc((size_t)linhas * colunas);
+    if (!celulas) {
+        perror("Erro ao alocar o labirinto");
+        return -1;
+    }
+
+    // Segunda passada: preencher as células
+    size_t c = 0;
+    int entradas = 0, saidas = 0;
+    for (size_t k = 0; k < tamanho; k++) {
+        if (texto[k] >= '0' && texto[k] <= '5') {
+            celulas[c] = texto[k] - '0';
+            entradas += celulas[c] == ENTRY;
+            saidas += celulas[c] == EXIT;
+            c++;
+        }
+    }
+    if (entradas == 0 || saidas == 0) {
+        fprintf(stderr, "%s: o labirinto precisa de uma entrada e de ao menos uma saída\n", filename);
+        free(celulas);
+        return -1;
+    }
+
+    int resultado = montaLabirinto(lab, linhas, colunas, celulas);
+    if (resultado == -1) perror("Erro ao montar o labirinto");
+    free(celulas);
+    return resultado;
+}
+
+// BFS reversa a partir de todas as saídas ao mesmo tempo: cada célula alcançada guarda a
+// direção do vizinho por onde foi descoberta, que é o primeiro passo de um caminho mínimo.
+// `proximo` chega zerado
+static int preencheDistancias(const Labirinto *lab, uint8_t *proximo) {
+    size_t total = (size_t)lab->linhas * lab->colunas;
+    int32_t *queue = malloc(total * sizeof(int32_t));
+    if (!queue) return -1;
+
+    size_t front = 0, rear = 0;
+    for (size_t k = 0; k < lab->num_saidas; k++) {
+        proximo[lab->saidas[k]] = CHEGADA;
+        queue[rear++] = lab->saidas[k];
+    }
+
+    int32_t colunas = lab->colunas;
+    int32_t deslocamento[5] = {0, -colunas, 1, colunas, -1};
+    int oposta[5] = {0, 3, 4, 1, 2};
+    while (front < rear) {
+        int32_t current = queue[front++];
+        int pos[2] = {current / colunas, current % colunas};
+        uint8_t livres = movimentosValidos(lab, pos);
+        for (int d = 1; d <= 4; d++) {
+            if (!(livres & (1 << (d - 1)))) continue;
+            int32_t vizinho = current + deslocamento[d];
+            if (proximo[vizinho] == 0) {
+                proximo[vizinho] = (uint8_t)oposta[d]; // Do vizinho, volta-se para `current`
+                queue[rear++] = vizinho;
+            }
+        }
+    }
+    free(queue);
+    return 0;
+}
+
+int calculaDistancias(Labirinto *lab) {
+    uint8_t *proximo = calloc((size_t)lab->linhas * lab->colunas, 1);
+    if (!proximo || preencheDistancias(lab, proximo) == -1) {
+        free(proximo);
+        return -1;
+    }
+    free(lab->proximo);
+    lab->proximo = proximo;
+    return 0;
+}
+
+// A tabela de um arquivo binário precisa ser a que o compilador calcularia: uma tabela
+// qualquer poderia ter ciclos, e a dica seguiria o ciclo sem chegar à saída. Retorna 1 se
+// confere, 0 se não e -1 sem memória
+static int distanciasConferem(const Labirinto *lab) {
+    size_t total = (size_t)lab->linhas * lab->colunas;
+    uint8_t *proximo = calloc(total, 1);
+    if (!proximo || preencheDistancias(lab, proximo) == -1) {
+        free(proximo);
+        return -1;
+    }
+    int conferem = memcmp(proximo, lab->proximo, total) == 0;
+    free(proximo);
+    return conferem;
+}
+
+// Os planos de um arquivo binário precisam descrever um labirinto que o formato texto
+// aceitaria: tipos de 0 a 5, a entrada em uma célula ENTRY e `livres` marcando exatamente as
+// células que não são WALL. `proximo` é conferido à parte (distanciasConferem)
+static int validaPlanos(const Labirinto *lab) {
+    size_t linhas = lab->linhas, colunas = lab->colunas;
+    for (size_t c = 0; c < linhas * colunas; c++) {
+        if (tipoIndice(lab, c) > PLAYER) return -1;
+    }
+    if (tipoCelula(lab, lab->entrada[0], lab->entrada[1]) != ENTRY) return -1;
+
+    // Palavra a palavra, com a borda e a palavra extra do fim zeradas
+    for (size_t x = 0; x < linhas + 2; x++) {
+        for (size_t w = 0; w < lab->palavras; w++) {
+            uint64_t esperado = 0;
+            for (size_t b = 0; b < 64; b++) {
+                size_t y = w * 64 + b; // Coluna contando a borda
+                if (x >= 1 && x <= linhas && y >= 1 && y <= colunas && tipoCelula(lab, (int)x - 1, (int)y - 1) != WALL) {
+                    esperado |= 1ull << b;
+                }
+            }
+            if (lab->livres[x * lab->palavras + w] != esperado) return -1;
+        }
+    }
+    return lab->livres[(linhas + 2) * lab->palavras] == 0 ? 0 : -1;
+}
+
+// Valida o arquivo mapeado e aponta os planos do labirinto para dentro dele
+static int carregaBinario(const char *filename, void *mapa, size_t tamanho, Labirinto *lab) {
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+    fprintf(stderr, "%s: o formato binário só é suportado em máquinas little-endian\n", filename);
+    return -1;
+#endif
+    const uint8_t *dados = mapa;
+    CabecalhoBinario cab;
+    if (tamanho < sizeof(cab)) {
+        fprintf(stderr, "%s: arquivo binário truncado\n", filename);
+        return -1;
+    }
+    memcpy(&cab, dados, sizeof(cab));
+
+    size_t linhas = cab.linhas, colunas = cab.colunas;
+    if (cab.versao != VERSAO_BINARIO || cab.tamanho != tamanho || linhas == 0 || colunas == 0
+        || linhas > UINT16_MAX || colunas > UINT16_MAX || linhas * colunas > INT32_MAX
+        || cab.entrada[0] < 0 || (size_t)cab.entrada[0] >= linhas
+        || cab.entrada[1] < 0 || (size_t)cab.entrada[1] >= colunas) {
+        fprintf(stderr, "%s: cabeçalho binário inválido\n", filename);
+        return -1;
+    }
+
+    // Cada plano precisa estar alinhado e caber no arquivo
+    uint64_t deslocamentos[3] = {cab.deslocamento_tipos, cab.deslocamento_livres, cab.deslocamento_proximo};
+    size_t tamanhos[3] = {bytesTipos(linhas, colunas), bytesLivres(linhas, colunas), linhas * colunas};
+    for (int k = 0; k < 3; k++) {
+        if (deslocamentos[k] % 8 != 0 || deslocamentos[k] < sizeof(cab)
+            || deslocamentos[k] > tamanho || tamanhos[k] > tamanho - deslocamentos[k]) {
+            fprintf(stderr, "%s: seções do arquivo binário inválidas\n", filename);
+            return -1;
+        }
+    }
+
+    if (somaVerificacao(dados + sizeof(cab), tamanho - sizeof(cab)) != cab.soma) {
+        fprintf(stderr, "%s: soma de verificação não confere\n", filename);
+        return -1;
+    }
+
+    lab->linhas = (int)linhas;
+    lab->colunas = (int)colunas;
+    lab->palavras = palavrasLinha(colunas);
+    lab->tipos = (uint8_t *)(dados + cab.deslocamento_tipos);
+    lab->livres = (uint64_t *)(dados + cab.deslocamento_livres);
+    lab->proximo = (uint8_t *)(dados + cab.deslocamento_proximo);
+    lab->entrada[0] = cab.entrada[0];
+    lab->entrada[1] = cab.entrada[1];
+    if (validaPlanos(lab) == -1) {
+        fprintf(stderr, "%s: planos do arquivo binário inconsistentes\n", filename);
+        return -1;
+    }
+    if (listaSaidas(lab) == -1) {
+        perror("Erro ao listar as saídas");
+        return -1;
+    }
+    if (lab->num_saidas == 0) {
+        fprintf(stderr, "%s: o labirinto precisa de ao menos uma saída\n", filename);
+        free(lab->saidas);
+        return -1;
+    }
+    int conferem = distanciasConferem(lab);
+    if (conferem != 1) {
+        if (conferem == -1) perror("Erro ao conferir a tabela de distâncias");
+        else fprintf(stderr, "%s: tabela de distâncias não confere com o labirinto\n", filename);
+        free(lab->saidas);
+        return -1;
+    }
+    lab->mapeamento = mapa;
+    lab->tamanho_mapeamento = tamanho;
+    return 0;
+}
+
+// Aceita o formato texto ou o binário gerado pelo compilador, que é mapeado somente
+// leitura e compartilhado entre processos pelo cache de páginas. Retorna -1 em erro
+int carregaLabirinto(const char *filename, Labirinto *lab) {
+    int fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        perror("Erro ao abrir o arquivo do labirinto");
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size == 0) {
+        fprintf(stderr, "%s: arquivo vazio ou ilegível\n", filename);
+        close(fd);
+        return -1;
+    }
+    size_t tamanho = (size_t)st.st_size;
+    void *mapa = mmap(NULL, tamanho, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapa == MAP_FAILED) {
+        perror("Erro ao mapear o arquivo do labirinto");
+        return -1;
+    }
+
+    int resultado;
+    if (tamanho >= 8 && memcmp(mapa, MAGICA_BINARIO, 8) == 0) {
+        resultado = carregaBinario(filename, mapa, tamanho, lab);
+        if (resultado == 0) return 0; // O mapeamento passa a pertencer ao labirinto
+    } else {
+        resultado = carregaTexto(filename, mapa, tamanho, lab);
+    }
+    munmap(mapa, tamanho);
+    return resultado;
+}
+
+// Grava o labirinto no formato binário. O arquivo é escrito ao lado e trocado de uma vez com
+// rename: servidores que já mapearam o anterior continuam vendo a versão inteira dele.
+// Retorna -1 em erro
+int salvaLabirintoBinario(const Labirinto *lab, const char *filename) {
+    size_t linhas = lab->linhas, colunas = lab->colunas;
+    CabecalhoBinario cab = {0};
+    memcpy(cab.magica, MAGICA_BINARIO, 8);
+    cab.versao = VERSAO_BINARIO;
+    cab.linhas = (uint32_t)linhas;
+    cab.colunas = (uint32_t)colunas;
+    cab.entrada[0] = lab->entrada[0];
+    cab.entrada[1] = lab->entrada[1];
+    cab.deslocamento_tipos = sizeof(cab);
+    cab.deslocamento_livres = alinha8(cab.deslocamento_tipos + bytesTipos(linhas, colunas));
+    cab.deslocamento_proximo = alinha8(cab.deslocamento_livres + bytesLivres(linhas, colunas));
+    cab.tamanho = alinha8(cab.deslocamento_proximo + linhas * colunas);
+
+    uint8_t *imagem = calloc(cab.tamanho, 1);
+    if (!imagem) return -1;
+    memcpy(imagem + cab.deslocamento_tipos, lab->tipos, bytesTipos(linhas, colunas));
+    memcpy(imagem + cab.deslocamento_livres, lab->livres, bytesLivres(linhas, colunas));
+    memcpy(imagem + cab.deslocamento_proximo, lab->proximo, linhas * colunas);
+    cab.soma = somaVerificacao(imagem + sizeof(cab), cab.tamanho - sizeof(cab));
+    memcpy(imagem, &cab, sizeof(cab));
+
+    char temporario[4096];
+    snprintf(temporario, sizeof(temporario), "%s.tmp", filename);
+    FILE *file = fopen(temporario, "wb");
+    int resultado = -1;
+    if (file) {
+        if (fwrite(imagem, 1, cab.tamanho, file) == cab.tamanho && fflush(file) == 0 && fsync(fileno(file)) == 0) resultado = 0;
+        if (fclose(file) != 0) resultado = -1;
+        if (resultado == 0 && rename(temporario, filename) == -1) resultado = -1;
+        if (resultado == -1) unlink(temporario);
+    }
+    free(imagem);
+    return resultado;
+}
+
+// Converte uma célula por byte nos planos compactos (tipos em nibbles e bitmap de livres),
+// encontra a entrada e calcula a tabela de distâncias
+int montaLabirinto(Labirinto *lab, int linhas, int colunas, const uint8_t *celulas) {
+    lab->linhas = linhas;
+    lab->colunas = colunas;
+    lab->palavras = palavrasLinha(colunas);
+    lab->proximo = NULL;
+    lab->saidas = NULL;
+    lab->mapeamento = NULL;
+    lab->tipos = calloc(bytesTipos(linhas, colunas), 1);
+    lab->livres = calloc(bytesLivres(linhas, colunas), 1);
+    if (!lab->tipos || !lab->livres) {
+        liberaLabirinto(lab);
+        return -1;
+    }
+
+    lab->entrada[0] = lab->entrada[1] = -1;
+    for (int i = 0; i < linhas; i++) {
+        for (int j = 0; j < colunas; j++) {
+            size_t c = (size_t)i * colunas + j;
+            int tipo = celulas[c];
+            lab->tipos[c / 2] |= (c % 2 == 0) ? tipo << 4 : tipo;
+            if (tipo != WALL) {
+                size_t bit = (size_t)(i + 1) * lab->palavras * 64 + (j + 1);
+                lab->livres[bit / 64] |= 1ull << (bit % 64);
+            }
+            if (tipo == ENTRY && lab->entrada[0] == -1) {
+                lab->entrada[0] = i;
+                lab->entrada[1] = j;
+            }
+        }
+    }
+    // Se não encontrar, o jogador começa em (0,0)
+    if (lab->entrada[0] == -1) {
+        lab->entrada[0] = lab->entrada[1] = 0;
+    }
+
+    if (listaSaidas(lab) == -1 || calculaDistancias(lab) == -1) {
+        liberaLabirinto(lab);
+        return -1;
+    }
+    return 0;
+}
+
+void liberaLabirinto(Labirinto *lab) {
+    if (lab->mapeamento) {
+        munmap(lab->mapeamento, lab->tamanho_mapeamento);
+        lab->mapeamento = NULL;
+    } else {
+        free(lab->tipos);
+        free(lab->livres);
+        free(lab->proximo);
+    }
+    free(lab->saidas);
+    lab->saidas = NULL;
+    lab->num_saidas = 0;
+    lab->tipos = NULL;
+    lab->livres = NULL;
+    lab->proximo = NULL;
+}
+
+// Máscara com um bit por direção livre (1 << (direção - 1)), tirada de três janelas de
+// 3 bits do bitmap; a borda de paredes dispensa testes de limite
+uint8_t movimentosValidos(const Labirinto *lab, int player_pos[2]) {
+    int x = player_pos[0], y = player_pos[1];
+    unsigned cima = janelaLivre(lab, x - 1, y);
+    unsigned meio = janelaLivre(lab, x, y);
+    unsigned baixo = janelaLivre(lab, x + 1, y);
+
+    return (uint8_t)(((cima >> 1) & 1)           // Cima
+                   | ((meio >> 2) & 1) << 1      // Direita
+                   | ((baixo >> 1) & 1) << 2     // Baixo
+                   | (meio & 1) << 3);           // Esquerda
+}
+
+// Move o jogador se a direção estiver livre. Retorna 0 quando ele chega à saída
+int atualizaPosicaoJogador(const Labirinto *lab, int *x, int *y, int direction) {
+    int pos[2] = {*x, *y};
+    if (!(movimentosValidos(lab, pos) & (1 << (direction - 1)))) {
+        return 1; // Parede ou borda: o jogador não sai do lugar
+    }
+
+    if (direction == 1) {
+        (*x)--; // Cima
+    } else if (direction == 2) {
+        (*y)++; // Direita
+    } else if (direction == 3) {
+        (*x)++; // Baixo
+    } else if (direction == 4) {
+        (*y)--; // Esquerda
+    }
+
+    return tipoCelula(lab, *x, *y) != EXIT;
+}
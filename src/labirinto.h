@@ -0,0 +1,72 @@
+#ifndef LABIRINTO_H
+#define LABIRINTO_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Representação do labirinto
+#define WALL 0
+#define PATH 1
+#define ENTRY 2
+#define EXIT 3
+#define UNKNOWN 4
+#define PLAYER 5
+
+#define CHEGADA 5 // Valor de Labirinto.proximo nas células de saída
+
+// Labirinto de tamanho arbitrário; as dimensões vêm do arquivo.
+// Depois da carga é somente leitura: a posição de cada jogador fica na sua sessão,
+// então uma única cópia atende todas as conexões
+typedef struct {
+    int linhas, colunas;
+    // Tipo de cada célula em 4 bits, linha a linha, nibble alto primeiro (mesmo formato
+    // do tabuleiro no protocolo)
+    uint8_t *tipos;
+    // Um bit por célula livre (não WALL), com uma borda de paredes ao redor do labirinto:
+    // a célula (x, y) é o bit (x + 1) * palavras * 64 + (y + 1)
+    uint64_t *livres;
+    size_t palavras; // Palavras de 64 bits por linha de `livres`
+    // Direção do próximo passo rumo à saída mais próxima (0 se não há caminho, CHEGADA na saída)
+    uint8_t *proximo;
+    int entrada[2];   // Posição inicial do jogador
+    int32_t *saidas;  // Índices (x * colunas + y) de todas as células de saída
+    size_t num_saidas;
+    // Arquivo binário mapeado que contém os planos acima, ou NULL se eles estão no heap
+    void *mapeamento;
+    size_t tamanho_mapeamento;
+} Labirinto;
+
+static inline int tipoIndice(const Labirinto *lab, size_t i) {
+    return (i % 2 == 0) ? lab->tipos[i / 2] >> 4 : lab->tipos[i / 2] & 0x0F;
+}
+
+static inline int tipoCelula(const Labirinto *lab, int x, int y) {
+    return tipoIndice(lab, (size_t)x * lab->colunas + y);
+}
+
+// Aceita também a borda: x em [-1, linhas] e y em [-1, colunas]
+static inline int celulaLivre(const Labirinto *lab, int x, int y) {
+    size_t bit = (size_t)(x + 1) * lab->palavras * 64 + (y + 1);
+    return (lab->livres[bit / 64] >> (bit % 64)) & 1;
+}
+
+// Bits de livres das colunas y - 1, y e y + 1 da linha x (bit 0 = y - 1)
+static inline unsigned janelaLivre(const Labirinto *lab, int x, int y) {
+    size_t bit = (size_t)(x + 1) * lab->palavras * 64 + y;
+    const uint64_t *p = lab->livres + bit / 64;
+    unsigned deslocamento = bit % 64;
+    uint64_t v = p[0] >> deslocamento;
+    if (deslocamento > 61) v |= p[1] << (64 - deslocamento);
+    return (unsigned)(v & 7);
+}
+
+int carregaLabirinto(const char *filename, Labirinto *lab);
+int salvaLabirintoBinario(const Labirinto *lab, const char *filename);
+int montaLabirinto(Labirinto *lab, int linhas, int colunas, const uint8_t *celulas);
+int calculaDistancias(Labirinto *lab);
+void liberaLabirinto(Labirinto *lab);
+
+uint8_t movimentosValidos(const Labirinto *lab, int player_pos[2]);
+int atualizaPosicaoJogador(const Labirinto *lab, int *x, int *y, int direction);
+
+#endif
@@ -0,0 +1,183 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "lote.h"
+#include "labirinto.h"
+#include "busca.h"
+#include "metricas.h"
+#include "sessao.h"
+
+typedef struct {
+    char **arquivos;
+    size_t num_arquivos, capacidade;
+    _Atomic size_t proximo; // Próximo arquivo a resolver; cada thread pega um por vez
+    int motor;
+    _Atomic size_t alcancaveis, sem_caminho, erros;
+    _Atomic uint64_t passos, carga_ns, busca_ns;
+} Lote;
+
+static int acrescentaArquivo(Lote *lote, const char *caminho) {
+    if (lote->num_arquivos == lote->capacidade) {
+        size_t capacidade = lote->capacidade ? lote->capacidade * 2 : 1024;
+        char **arquivos = realloc(lote->arquivos, capacidade * sizeof(char *));
+        if (!arquivos) return -1;
+        lote->arquivos = arquivos;
+        lote->capacidade = capacidade;
+    }
+    lote->arquivos[lote->num_arquivos] = strdup(caminho);
+    return lote->arquivos[lote->num_arquivos++] ? 0 : -1;
+}
+
+static int comparaNomes(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// Arquivos regulares do diretório, em ordem de nome para a saída ser reprodutível
+static int acrescentaDiretorio(Lote *lote, const char *diretorio) {
+    DIR *dir = opendir(diretorio);
+    if (!dir) {
+        perror(diretorio);
+        return -1;
+    }
+    size_t antes = lote->num_arquivos;
+    char caminho[4096];
+    struct dirent *entrada;
+    while ((entrada = readdir(dir))) {
+        if (entrada->d_name[0] == '.') continue;
+        snprintf(caminho, sizeof(caminho), "%s/%s", diretorio, entrada->d_name);
+        struct stat info;
+        bool regular = entrada->d_type == DT_REG
+                    || (entrada->d_type == DT_UNKNOWN && stat(caminho, &info) == 0 && S_ISREG(info.st_mode));
+        if (regular && acrescentaArquivo(lote, caminho) == -1) {
+            closedir(dir);
+            return -1;
+        }
+    }
+    closedir(dir);
+    qsort(lote->arquivos + antes, lote->num_arquivos - antes, sizeof(char *), comparaNomes);
+    return 0;
+}
+
+static int acrescentaLista(Lote *lote, const char *lista) {
+    FILE *file = fopen(lista, "r");
+    if (!file) {
+        perror(lista);
+        return -1;
+    }
+    char *linha = NULL;
+    size_t capacidade = 0;
+    ssize_t n;
+    int resultado = 0;
+    while (resultado == 0 && (n = getline(&linha, &capacidade, file)) != -1) {
+        while (n > 0 && (linha[n - 1] == '\n' || linha[n - 1] == '\r')) linha[--n] = '\0';
+        if (n > 0) resultado = acrescentaArquivo(lote, linha);
+    }
+    free(linha);
+    fclose(file);
+    return resultado;
+}
+
+static void *loopLote(void *arg) {
+    Lote *lote = arg;
+    AreaBusca area = {0};
+    Caminho caminho = {0};
+    size_t i;
+    while ((i = atomic_fetch_add(&lote->proximo, 1)) < lote->num_arquivos) {
+        const char *arquivo = lote->arquivos[i];
+        Labirinto lab;
+        uint64_t inicio = agoraNs();
+        if (carregaLabirinto(arquivo, &lab) == -1) {
+            atomic_fetch_add(&lote->erros, 1);
+            printf("%s\terro\n", arquivo);
+            continue;
+        }
+        uint64_t carregado = agoraNs();
+        int resultado = buscaComMotor(lote->motor, &lab, lab.entrada[0], lab.entrada[1], &area, &caminho);
+        uint64_t fim = agoraNs();
+
+        // Partir de uma saída é um caminho de 0 passos
+        bool alcancavel = resultado == 0 && (caminho.tamanho > 0 || tipoCelula(&lab, lab.entrada[0], lab.entrada[1]) == EXIT);
+        if (resultado == -1) {
+            atomic_fetch_add(&lote->erros, 1);
+        } else {
+            atomic_fetch_add(alcancavel ? &lote->alcancaveis : &lote->sem_caminho, 1);
+            atomic_fetch_add(&lote->passos, caminho.tamanho);
+            atomic_fetch_add(&lote->carga_ns, carregado - inicio);
+            atomic_fetch_add(&lote->busca_ns, fim - carregado);
+        }
+        // Uma chamada de printf por linha: linhas de threads diferentes não se misturam
+        printf("%s\t%s\t%dx%d\t%zu\t%zu\t%.3f\t%.3f\n", arquivo,
+               resultado == -1 ? "sem_memoria" : alcancavel ? "ok" : "sem_caminho", lab.linhas, lab.colunas,
+               lab.num_saidas, alcancavel ? caminho.tamanho : 0, (carregado - inicio) / 1e6, (fim - carregado) / 1e6);
+        liberaLabirinto(&lab);
+    }
+    liberaAreaBusca(&area);
+    liberaCaminho(&caminho);
+    return NULL;
+}
+
+static void usoLote(void) {
+    fprintf(stderr, "Uso: server -S <arquivo|diretório|@lista>... [-t threads] [-m tabela|bfs|astar|bidirecional|jps]\n");
+}
+
+int executaLote(int argc, char *argv[]) {
+    Lote lote = {.motor = MOTOR_TABELA};
+    int num_threads = 1;
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            num_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc && motorPorNome(argv[i + 1]) != -1) {
+            lote.motor = motorPorNome(argv[++i]);
+        } else if (argv[i][0] == '@') {
+            if (acrescentaLista(&lote, argv[i] + 1) == -1) return EXIT_FAILURE;
+        } else {
+            struct stat info;
+            if (stat(argv[i], &info) == -1) {
+                perror(argv[i]);
+                return EXIT_FAILURE;
+            }
+            int resultado = S_ISDIR(info.st_mode) ? acrescentaDiretorio(&lote, argv[i]) : acrescentaArquivo(&lote, argv[i]);
+            if (resultado == -1) return EXIT_FAILURE;
+        }
+    }
+    if (lote.num_arquivos == 0 || num_threads < 1 || num_threads > MAX_WORKERS) {
+        usoLote();
+        return EXIT_FAILURE;
+    }
+    if ((size_t)num_threads > lote.num_arquivos) num_threads = (int)lote.num_arquivos;
+
+    printf("# arquivo\tsituacao\tdimensoes\tsaidas\tpassos\tcarga_ms\tbusca_ms\n");
+    uint64_t inicio = agoraNs();
+    pthread_t threads[MAX_WORKERS];
+    for (int t = 1; t < num_threads; t++) {
+        if (pthread_create(&threads[t], NULL, loopLote, &lote) != 0) {
+            fprintf(stderr, "Erro ao criar a thread %d\n", t);
+            return EXIT_FAILURE;
+        }
+    }
+    loopLote(&lote);
+    for (int t = 1; t < num_threads; t++) pthread_join(threads[t], NULL);
+    double segundos = (agoraNs() - inicio) / 1e9;
+
+    size_t alcancaveis = atomic_load(&lote.alcancaveis), sem_caminho = atomic_load(&lote.sem_caminho);
+    size_t erros = atomic_load(&lote.erros);
+    printf("# %zu arquivos em %.2f s (%.0f/s, %d threads, motor %s): %zu ok, %zu sem caminho, %zu com erro\n",
+           lote.num_arquivos, segundos, lote.num_arquivos / segundos, num_threads, nomeMotor(lote.motor), alcancaveis,
+           sem_caminho, erros);
+    size_t resolvidos = alcancaveis + sem_caminho;
+    if (resolvidos > 0) {
+        printf("# média por arquivo resolvido: %.1f passos, carga %.3f ms, busca %.3f ms\n",
+               (double)atomic_load(&lote.passos) / resolvidos, atomic_load(&lote.carga_ns) / 1e6 / resolvidos,
+               atomic_load(&lote.busca_ns) / 1e6 / resolvidos);
+    }
+
+    for (size_t i = 0; i < lote.num_arquivos; i++) free(lote.arquivos[i]);
+    free(lote.arquivos);
+    return sem_caminho == 0 && erros == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
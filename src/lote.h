@@ -0,0 +1,11 @@
+#ifndef LOTE_H
+#define LOTE_H
+
+// Modo em lote (server -S): carrega e resolve muitos arquivos de labirinto em paralelo, sem
+// abrir sockets, para validar labirintos antes de colocá-los em produção. Cada argumento é um
+// arquivo, um diretório (seus arquivos, sem descer em subdiretórios) ou @lista, um arquivo com
+// um caminho por linha. Imprime uma linha por arquivo e um resumo; retorna o código de saída
+// do processo (1 se algum arquivo não carregou ou não tem caminho até a saída)
+int executaLote(int argc, char *argv[]);
+
+#endif
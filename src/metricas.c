@@ -0,0 +1,241 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "metricas.h"
+#include "protocolo.h"
+#include "recarga.h"
+
+_Thread_local Metricas *metricas_thread;
+_Thread_local RingLog *log_thread;
+
+// Preenchidos antes das threads dos workers começarem; depois só são lidos
+static Metricas *todas_metricas[MAX_WORKERS];
+static RingLog *todos_logs[MAX_WORKERS];
+static _Atomic int num_registrados;
+
+static const char *nomes_pools[NUM_POOLS] = {
+    [POOL_SESSOES] = "sessoes", [POOL_BUFFERS] = "buffers", [POOL_ARENA] = "arena_bytes",
+};
+
+static const char *nomes_opcodes[NUM_OPCODES] = {
+    [ACTION_START] = "start", [ACTION_MOVE] = "move", [ACTION_MAP] = "map", [ACTION_HINT] = "hint",
+    [ACTION_RESET] = "reset", [ACTION_EXIT] = "exit", [ACTION_MOVE_BATCH] = "move_batch",
+    [ACTION_TOKEN] = "token", [ACTION_RESUME] = "resume", [ACTION_JOIN] = "join",
+};
+
+void registraWorker(Metricas *metricas, RingLog *log) {
+    int i = atomic_load(&num_registrados);
+    if (i >= MAX_WORKERS) return;
+    todas_metricas[i] = metricas;
+    todos_logs[i] = log;
+    atomic_store(&num_registrados, i + 1);
+}
+
+void registraPedido(Metricas *m, int opcode, uint64_t ns) {
+    if (opcode < 0 || opcode >= NUM_OPCODES) return;
+    int faixa = ns < 128 ? 0 : 63 - __builtin_clzll(ns) - 6;
+    if (faixa >= FAIXAS_LATENCIA) faixa = FAIXAS_LATENCIA - 1;
+    somaContador(&m->pedidos[opcode], 1);
+    somaContador(&m->tempo_ns[opcode], ns);
+    somaContador(&m->latencia[opcode][faixa], 1);
+}
+
+void registraLog(const char *formato, ...) {
+    RingLog *log = log_thread;
+    va_list args;
+    va_start(args, formato);
+    if (!log) {
+        // Fora dos workers (partida, erros fatais) a escrita direta não atrapalha ninguém
+        vprintf(formato, args);
+        va_end(args);
+        return;
+    }
+
+    uint64_t escrita = atomic_load_explicit(&log->escrita, memory_order_relaxed);
+    if (escrita - atomic_load_explicit(&log->leitura, memory_order_acquire) >= LOG_ENTRADAS) {
+        va_end(args);
+        if (metricas_thread) somaContador(&metricas_thread->logs_descartados, 1);
+        return;
+    }
+    vsnprintf(log->mensagens[escrita % LOG_ENTRADAS], LOG_TAMANHO, formato, args);
+    va_end(args);
+    atomic_store_explicit(&log->escrita, escrita + 1, memory_order_release);
+}
+
+// Esvazia as filas de log de todos os workers na saída padrão, em lotes
+static void *loopLog(void *arg) {
+    (void)arg;
+    struct timespec espera = {0, 10 * 1000 * 1000};
+    while (1) {
+        int escreveu = 0;
+        int n = atomic_load(&num_registrados);
+        for (int w = 0; w < n; w++) {
+            RingLog *log = todos_logs[w];
+            uint64_t leitura = atomic_load_explicit(&log->leitura, memory_order_relaxed);
+            uint64_t escrita = atomic_load_explicit(&log->escrita, memory_order_acquire);
+            for (; leitura < escrita; leitura++) {
+                fputs(log->mensagens[leitura % LOG_ENTRADAS], stdout);
+                escreveu = 1;
+            }
+            atomic_store_explicit(&log->leitura, leitura, memory_order_release);
+        }
+        if (escreveu) fflush(stdout);
+        nanosleep(&espera, NULL);
+    }
+    return NULL;
+}
+
+int iniciaLogAssincrono(void) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, loopLog, NULL) != 0) return -1;
+    pthread_detach(thread);
+    return 0;
+}
+
+static uint64_t soma(size_t deslocamento) {
+    uint64_t total = 0;
+    int n = atomic_load(&num_registrados);
+    for (int w = 0; w < n; w++) {
+        total += atomic_load_explicit((_Atomic uint64_t *)((char *)todas_metricas[w] + deslocamento), memory_order_relaxed);
+    }
+    return total;
+}
+
+#define SOMA(campo) soma(offsetof(Metricas, campo))
+
+// Formata todas as métricas no formato texto do Prometheus
+static size_t formataMetricas(char *buffer, size_t capacidade) {
+    size_t usado = 0;
+#define ESCREVE(...) usado += (size_t)snprintf(buffer + usado, usado < capacidade ? capacidade - usado : 0, __VA_ARGS__)
+
+    ESCREVE("# TYPE labirinto_pedidos_total counter\n");
+    for (int op = 0; op < NUM_OPCODES; op++) {
+        if (nomes_opcodes[op]) ESCREVE("labirinto_pedidos_total{acao=\"%s\"} %llu\n", nomes_opcodes[op], (unsigned long long)SOMA(pedidos[op]));
+    }
+    ESCREVE("# TYPE labirinto_tempo_segundos_total counter\n");
+    for (int op = 0; op < NUM_OPCODES; op++) {
+        if (nomes_opcodes[op]) ESCREVE("labirinto_tempo_segundos_total{acao=\"%s\"} %.9f\n", nomes_opcodes[op], SOMA(tempo_ns[op]) / 1e9);
+    }
+    ESCREVE("# TYPE labirinto_latencia_segundos histogram\n");
+    for (int op = 0; op < NUM_OPCODES; op++) {
+        if (!nomes_opcodes[op]) continue;
+        uint64_t acumulado = 0;
+        for (int f = 0; f < FAIXAS_LATENCIA; f++) {
+            acumulado += SOMA(latencia[op][f]);
+            ESCREVE("labirinto_latencia_segundos_bucket{acao=\"%s\",le=\"%g\"} %llu\n", nomes_opcodes[op],
+                    (double)(1ull << (f + 7)) / 1e9, (unsigned long long)acumulado);
+        }
+        ESCREVE("labirinto_latencia_segundos_bucket{acao=\"%s\",le=\"+Inf\"} %llu\n", nomes_opcodes[op], (unsigned long long)acumulado);
+        ESCREVE("labirinto_latencia_segundos_count{acao=\"%s\"} %llu\n", nomes_opcodes[op], (unsigned long long)acumulado);
+        ESCREVE("labirinto_latencia_segundos_sum{acao=\"%s\"} %.9f\n", nomes_opcodes[op], SOMA(tempo_ns[op]) / 1e9);
+    }
+    ESCREVE("# TYPE labirinto_bytes_recebidos_total counter\nlabirinto_bytes_recebidos_total %llu\n", (unsigned long long)SOMA(bytes_recebidos));
+    ESCREVE("# TYPE labirinto_bytes_enviados_total counter\nlabirinto_bytes_enviados_total %llu\n", (unsigned long long)SOMA(bytes_enviados));
+    ESCREVE("# TYPE labirinto_nos_expandidos_total counter\nlabirinto_nos_expandidos_total %llu\n", (unsigned long long)SOMA(nos_expandidos));
+    ESCREVE("# TYPE labirinto_passos_dica_total counter\nlabirinto_passos_dica_total %llu\n", (unsigned long long)SOMA(passos_dica));
+    ESCREVE("# TYPE labirinto_gerados_total counter\nlabirinto_gerados_total %llu\n", (unsigned long long)SOMA(labirintos_gerados));
+    ESCREVE("# TYPE labirinto_cache_acertos_total counter\nlabirinto_cache_acertos_total %llu\n", (unsigned long long)SOMA(cache_acertos));
+    ESCREVE("# TYPE labirinto_recusados_total counter\nlabirinto_recusados_total %llu\n", (unsigned long long)SOMA(labirintos_recusados));
+    ESCREVE("# TYPE labirinto_sala_blocos_total counter\nlabirinto_sala_blocos_total %llu\n", (unsigned long long)SOMA(blocos_sala));
+    ESCREVE("# TYPE labirinto_sala_entregas_total counter\nlabirinto_sala_entregas_total %llu\n", (unsigned long long)SOMA(entregas_sala));
+    ESCREVE("# TYPE labirinto_sala_ressincronizacoes_total counter\nlabirinto_sala_ressincronizacoes_total %llu\n", (unsigned long long)SOMA(ressincronizacoes_sala));
+    ESCREVE("# TYPE labirinto_sessoes_ativas gauge\nlabirinto_sessoes_ativas %lld\n", (long long)SOMA(sessoes_ativas));
+    ESCREVE("# TYPE labirinto_logs_descartados_total counter\nlabirinto_logs_descartados_total %llu\n", (unsigned long long)SOMA(logs_descartados));
+    ESCREVE("# TYPE labirinto_sessoes_ociosas_total counter\nlabirinto_sessoes_ociosas_total %llu\n", (unsigned long long)SOMA(sessoes_ociosas));
+    ESCREVE("# TYPE labirinto_pedidos_limitados_total counter\nlabirinto_pedidos_limitados_total %llu\n", (unsigned long long)SOMA(pedidos_limitados));
+    EstatisticasRecarga recarga = estatisticasRecarga();
+    ESCREVE("# TYPE labirinto_versao gauge\nlabirinto_versao %u\n", recarga.versao);
+    ESCREVE("# TYPE labirinto_recargas_total counter\nlabirinto_recargas_total %llu\n", (unsigned long long)recarga.recargas);
+    ESCREVE("# TYPE labirinto_recargas_falhas_total counter\nlabirinto_recargas_falhas_total %llu\n", (unsigned long long)recarga.falhas);
+    ESCREVE("# TYPE labirinto_gravacao_descartados_total counter\nlabirinto_gravacao_descartados_total %llu\n", (unsigned long long)SOMA(gravacao_descartados));
+    // A marca d'água é por worker; a soma é o pior caso de todos os workers ao mesmo tempo
+    const char *campos[3] = {"em_uso", "maximo", "capacidade"};
+    for (int c = 0; c < 3; c++) {
+        ESCREVE("# TYPE labirinto_pool_%s gauge\n", campos[c]);
+        for (int p = 0; p < NUM_POOLS; p++) {
+            size_t base = offsetof(Metricas, pools) + p * sizeof(EstatisticasPool);
+            size_t campo = c == 0 ? offsetof(EstatisticasPool, em_uso) : c == 1 ? offsetof(EstatisticasPool, maximo) : offsetof(EstatisticasPool, capacidade);
+            ESCREVE("labirinto_pool_%s{pool=\"%s\"} %llu\n", campos[c], nomes_pools[p], (unsigned long long)soma(base + campo));
+        }
+    }
+#undef ESCREVE
+    return usado < capacidade ? usado : capacidade - 1;
+}
+
+// Cada conexão recebe um retrato das métricas e é fechada (compatível com `curl` e com o Prometheus).
+// POST /recarrega pede a recarga do labirinto, como o SIGHUP, e responde sem esperar por ela
+static void *loopMetricas(void *arg) {
+    int server_socket = (int)(intptr_t)arg;
+    size_t capacidade = 256 * 1024;
+    char *corpo = malloc(capacidade);
+    char cabecalho[160];
+    while (corpo) {
+        int cliente = accept(server_socket, NULL, NULL);
+        if (cliente == -1) continue;
+        char pedido[1024];
+        struct timeval limite = {1, 0};
+        setsockopt(cliente, SOL_SOCKET, SO_RCVTIMEO, &limite, sizeof(limite));
+        ssize_t lidos = recv(cliente, pedido, sizeof(pedido), 0); // Fora a recarga, o pedido é ignorado
+
+        size_t tamanho;
+        const char *situacao = "200 OK";
+        if (lidos >= 15 && memcmp(pedido, "POST /recarrega", 15) == 0) {
+            pedeRecarga();
+            situacao = "202 Accepted";
+            tamanho = (size_t)snprintf(corpo, capacidade, "recarga pedida\n");
+        } else {
+            tamanho = formataMetricas(corpo, capacidade);
+        }
+        int n = snprintf(cabecalho, sizeof(cabecalho),
+                         "HTTP/1.0 %s\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\n\r\n", situacao, tamanho);
+        send(cliente, cabecalho, n, MSG_NOSIGNAL);
+        send(cliente, corpo, tamanho, MSG_NOSIGNAL);
+        close(cliente);
+    }
+    return NULL;
+}
+
+// Abre a porta de métricas só na interface de loopback
+int iniciaServidorMetricas(const char *ip_version, int port) {
+    struct sockaddr_storage addr = {0};
+    socklen_t addr_len;
+    int domain;
+    if (strcmp(ip_version, "v6") == 0) {
+        struct sockaddr_in6 *a = (struct sockaddr_in6 *)&addr;
+        a->sin6_family = domain = AF_INET6;
+        a->sin6_port = htons(port);
+        a->sin6_addr = in6addr_loopback;
+        addr_len = sizeof(*a);
+    } else {
+        struct sockaddr_in *a = (struct sockaddr_in *)&addr;
+        a->sin_family = domain = AF_INET;
+        a->sin_port = htons(port);
+        a->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr_len = sizeof(*a);
+    }
+
+    int server_socket = socket(domain, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int reuse = 1;
+    if (server_socket == -1) return -1;
+    setsockopt(server_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (bind(server_socket, (struct sockaddr *)&addr, addr_len) == -1 || listen(server_socket, 16) == -1) {
+        close(server_socket);
+        return -1;
+    }
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, loopMetricas, (void *)(intptr_t)server_socket) != 0) {
+        close(server_socket);
+        return -1;
+    }
+    pthread_detach(thread);
+    return 0;
+}
@@ -0,0 +1,81 @@
+#ifndef METRICAS_H
+#define METRICAS_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+// Contadores por worker. Cada worker é o único escritor dos seus contadores, então basta
+// carregar e gravar com ordem relaxada, sem instruções com lock; a thread de estatísticas
+// só lê e soma os valores de todos os workers.
+
+#define NUM_OPCODES 16     // Opcodes medidos (índice = opcode do pedido)
+#define FAIXAS_LATENCIA 24 // Faixa i: até 2^(i + 7) ns, de 128 ns a ~1 s
+#define MAX_WORKERS 256
+
+// Ocupação de um pool ou arena do worker (objetos, ou bytes no caso da arena)
+typedef struct {
+    _Atomic uint64_t em_uso;
+    _Atomic uint64_t maximo; // Marca d'água desde a partida
+    _Atomic uint64_t capacidade;
+} EstatisticasPool;
+
+#define POOL_SESSOES 0
+#define POOL_BUFFERS 1
+#define POOL_ARENA 2
+#define NUM_POOLS 3
+
+typedef struct {
+    _Atomic uint64_t pedidos[NUM_OPCODES];
+    _Atomic uint64_t tempo_ns[NUM_OPCODES];
+    _Atomic uint64_t latencia[NUM_OPCODES][FAIXAS_LATENCIA];
+    _Atomic uint64_t bytes_recebidos;
+    _Atomic uint64_t bytes_enviados;
+    _Atomic uint64_t nos_expandidos; // Células (ou pontos de salto) expandidas pelos motores de busca
+    _Atomic uint64_t passos_dica;    // Passos seguidos na tabela de distâncias
+    _Atomic uint64_t labirintos_gerados; // Pedidos à thread de geração (semente fora do cache)
+    _Atomic uint64_t cache_acertos;
+    _Atomic uint64_t labirintos_recusados; // Acima do lado ou dos bytes de -G
+    _Atomic uint64_t blocos_sala;       // ACTION_ROOM_DELTA serializados (um por sala e volta)
+    _Atomic uint64_t entregas_sala;     // Referências a blocos postas em filas de saída
+    _Atomic uint64_t ressincronizacoes_sala; // Estados inteiros enviados a inscritos atrasados
+    _Atomic int64_t sessoes_ativas;
+    _Atomic uint64_t logs_descartados;
+    _Atomic uint64_t gravacao_descartados; // Registros de -r perdidos com o buffer do worker cheio
+    _Atomic uint64_t sessoes_ociosas;   // Encerradas pelo temporizador de ociosidade
+    _Atomic uint64_t pedidos_limitados; // ACTION_HINT e ACTION_MAP que esperaram ficha
+    EstatisticasPool pools[NUM_POOLS];
+} Metricas;
+
+// Fila de mensagens de log de um worker (um produtor, um consumidor). Quando está cheia a
+// mensagem é descartada e contada, para que o worker nunca espere pela saída padrão
+#define LOG_ENTRADAS 1024
+#define LOG_TAMANHO 120
+
+typedef struct {
+    char mensagens[LOG_ENTRADAS][LOG_TAMANHO];
+    _Atomic uint64_t escrita;
+    _Atomic uint64_t leitura;
+} RingLog;
+
+// Métricas e log do worker da thread atual (NULL fora dos workers)
+extern _Thread_local Metricas *metricas_thread;
+extern _Thread_local RingLog *log_thread;
+
+static inline void somaContador(_Atomic uint64_t *contador, uint64_t valor) {
+    atomic_store_explicit(contador, atomic_load_explicit(contador, memory_order_relaxed) + valor, memory_order_relaxed);
+}
+
+static inline void somaSessoes(int64_t valor) {
+    if (!metricas_thread) return;
+    _Atomic int64_t *c = &metricas_thread->sessoes_ativas;
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + valor, memory_order_relaxed);
+}
+
+void registraPedido(Metricas *m, int opcode, uint64_t ns);
+void registraWorker(Metricas *metricas, RingLog *log);
+void registraLog(const char *formato, ...) __attribute__((format(printf, 1, 2)));
+
+int iniciaLogAssincrono(void);
+int iniciaServidorMetricas(const char *ip_version, int port);
+
+#endif
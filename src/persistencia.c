@@ -0,0 +1,425 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/random.h>
+#include <sys/stat.h>
+
+#include "persistencia.h"
+#include "protocolo.h"
+
+#define FATIAS 64          // Travas independentes: workers raramente disputam a mesma
+#define BALDES_FATIA 4096  // Listas encadeadas por fatia
+#define WAL_INTERVALO_MS 10 // Um write e um fdatasync por intervalo, com tudo o que chegou nele
+#define WAL_COMPACTACAO (64u << 20) // Bytes acrescentados (ou o tamanho da última compactação, se maior) até compactar de novo
+
+// Registro do WAL: u32 tamanho do corpo, corpo, u32 soma do corpo. Corpo: u64 token, u16 lado,
+// u64 semente, u16 linha, u16 coluna, u32 movimentos, u32 palavras, u32 n e n pares
+// (u32 índice, u64 palavra) com só as palavras não nulas do conjunto de reveladas. Um corpo
+// só com o u64 token é uma lápide: a partida foi retomada e o retrato anterior não vale mais
+#define CORPO_FIXO 34
+#define CORPO_LAPIDE 8
+#define PALAVRA_ESPARSA 12
+
+typedef struct {
+    pthread_mutex_t trava;
+    Snapshot *baldes[BALDES_FATIA];
+} Fatia;
+
+static Fatia fatias[FATIAS] = {[0 ... FATIAS - 1] = {.trava = PTHREAD_MUTEX_INITIALIZER}};
+
+static struct {
+    pthread_mutex_t trava;
+    uint8_t *dados; // Registros esperando a thread de gravação
+    size_t tamanho, capacidade;
+    pthread_mutex_t escrita; // Do arquivo e do lote: a thread de gravação ou o encerramento
+    uint8_t *lote;           // Buffer sendo gravado, trocado com `dados`
+    size_t capacidade_lote;
+    const char *arquivo;
+    size_t compactado; // Tamanho do arquivo na última compactação
+    int fd;
+    bool ativo;
+} wal = {.trava = PTHREAD_MUTEX_INITIALIZER, .escrita = PTHREAD_MUTEX_INITIALIZER, .fd = -1};
+
+static volatile sig_atomic_t encerrando; // SIGTERM ou SIGINT: grava o que falta e sai
+
+static Snapshot **balde(uint64_t token, Fatia **fatia) {
+    *fatia = &fatias[token % FATIAS];
+    return &(*fatia)->baldes[(token / FATIAS) % BALDES_FATIA];
+}
+
+uint64_t novoToken(void) {
+    static _Atomic uint64_t contador;
+    uint64_t token = 0;
+    while (token == 0) {
+        if (getrandom(&token, sizeof(token), 0) != sizeof(token)) {
+            // Sem getrandom: mistura o relógio com um contador
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            token = ((uint64_t)ts.tv_sec << 30) ^ ts.tv_nsec ^ (++contador * 0x9E3779B97F4A7C15ull);
+        }
+    }
+    return token;
+}
+
+void liberaSnapshot(Snapshot *snap) {
+    if (!snap) return;
+    free(snap->reveladas);
+    free(snap);
+}
+
+static uint32_t somaRegistro(const uint8_t *dados, size_t tamanho) {
+    uint32_t h = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < tamanho; i++) h = (h ^ dados[i]) * 16777619u;
+    return h;
+}
+
+// Acrescenta o registro ao buffer da thread de gravação. Chamado com a trava da fatia do
+// token, para que os registros de um token fiquem no WAL na mesma ordem das mudanças na tabela
+static void acrescentaWal(const uint8_t *registro, size_t tamanho) {
+    pthread_mutex_lock(&wal.trava);
+    if (wal.tamanho + tamanho > wal.capacidade) {
+        size_t capacidade = wal.capacidade ? wal.capacidade : 64 * 1024;
+        while (capacidade < wal.tamanho + tamanho) capacidade *= 2;
+        uint8_t *dados = realloc(wal.dados, capacidade);
+        if (dados) {
+            wal.dados = dados;
+            wal.capacidade = capacidade;
+        }
+    }
+    if (wal.tamanho + tamanho <= wal.capacidade) {
+        memcpy(wal.dados + wal.tamanho, registro, tamanho);
+        wal.tamanho += tamanho;
+    }
+    pthread_mutex_unlock(&wal.trava);
+}
+
+// Insere ou substitui; o registro (se houver) vai para o WAL junto
+static void insere(Snapshot *snap, const uint8_t *registro, size_t tamanho) {
+    Fatia *fatia;
+    Snapshot **lista = balde(snap->token, &fatia);
+    pthread_mutex_lock(&fatia->trava);
+    Snapshot *antigo = NULL;
+    for (Snapshot **p = lista; *p; p = &(*p)->proximo) {
+        if ((*p)->token == snap->token) {
+            antigo = *p;
+            *p = antigo->proximo;
+            break;
+        }
+    }
+    snap->proximo = *lista;
+    *lista = snap;
+    if (tamanho) acrescentaWal(registro, tamanho);
+    pthread_mutex_unlock(&fatia->trava);
+    liberaSnapshot(antigo);
+}
+
+Snapshot *retiraSnapshot(uint64_t token) {
+    Fatia *fatia;
+    Snapshot **p = balde(token, &fatia);
+    pthread_mutex_lock(&fatia->trava);
+    for (; *p; p = &(*p)->proximo) {
+        if ((*p)->token == token) {
+            if ((*p)->ativa) break; // A partida está com outra sessão
+            Snapshot *snap = *p;
+            *p = snap->proximo;
+            if (wal.ativo) {
+                uint8_t lapide[4 + CORPO_LAPIDE + 4];
+                escreveU32(lapide, CORPO_LAPIDE);
+                escreveU64(lapide + 4, token);
+                escreveU32(lapide + 4 + CORPO_LAPIDE, somaRegistro(lapide + 4, CORPO_LAPIDE));
+                acrescentaWal(lapide, sizeof(lapide));
+            }
+            pthread_mutex_unlock(&fatia->trava);
+            snap->proximo = NULL;
+            return snap;
+        }
+    }
+    pthread_mutex_unlock(&fatia->trava);
+    return NULL;
+}
+
+bool consultaSnapshot(uint64_t token, uint16_t *lado, uint64_t *semente) {
+    Fatia *fatia;
+    Snapshot **p = balde(token, &fatia);
+    bool achou = false;
+    pthread_mutex_lock(&fatia->trava);
+    for (Snapshot *snap = *p; snap; snap = snap->proximo) {
+        if (snap->token == token) {
+            if (snap->ativa) break;
+            *lado = snap->lado;
+            *semente = snap->semente;
+            achou = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&fatia->trava);
+    return achou;
+}
+
+// Serializa o retrato em um buffer alocado; retorna o tamanho ou 0 sem memória
+static size_t serializa(const Snapshot *snap, uint8_t **saida) {
+    uint32_t n = 0;
+    for (size_t i = 0; i < snap->palavras; i++) n += snap->reveladas[i] != 0;
+    size_t corpo = CORPO_FIXO + (size_t)n * PALAVRA_ESPARSA;
+    uint8_t *b = malloc(4 + corpo + 4);
+    if (!b) return 0;
+
+    uint8_t *p = b;
+    escreveU32(p, (uint32_t)corpo);
+    escreveU64(p + 4, snap->token);
+    escreveU16(p + 12, snap->lado);
+    escreveU64(p + 14, snap->semente);
+    escreveU16(p + 22, snap->linha);
+    escreveU16(p + 24, snap->coluna);
+    escreveU32(p + 26, snap->movimentos);
+    escreveU32(p + 30, (uint32_t)snap->palavras);
+    escreveU32(p + 34, n);
+    p += 4 + CORPO_FIXO;
+    for (size_t i = 0; i < snap->palavras; i++) {
+        if (!snap->reveladas[i]) continue;
+        escreveU32(p, (uint32_t)i);
+        escreveU64(p + 4, snap->reveladas[i]);
+        p += PALAVRA_ESPARSA;
+    }
+    escreveU32(p, somaRegistro(b + 4, corpo));
+    *saida = b;
+    return 4 + corpo + 4;
+}
+
+// Lê um registro; retorna seu tamanho total ou 0 se estiver incompleto ou corrompido.
+// Uma lápide dá *saida NULL e o token em *token
+static size_t desserializa(const uint8_t *dados, size_t disponivel, Snapshot **saida, uint64_t *token) {
+    if (disponivel < 4) return 0;
+    size_t corpo = leU32(dados);
+    if ((corpo < CORPO_FIXO && corpo != CORPO_LAPIDE) || disponivel < 4 + corpo + 4) return 0;
+    if (leU32(dados + 4 + corpo) != somaRegistro(dados + 4, corpo)) return 0;
+
+    const uint8_t *p = dados + 4;
+    *token = leU64(p);
+    if (corpo == CORPO_LAPIDE) {
+        *saida = NULL;
+        return 4 + corpo + 4;
+    }
+    uint32_t palavras = leU32(p + 26), n = leU32(p + 30);
+    if (corpo != CORPO_FIXO + (size_t)n * PALAVRA_ESPARSA || n > palavras) return 0;
+
+    Snapshot *snap = calloc(1, sizeof(Snapshot));
+    if (!snap) return 0;
+    snap->token = leU64(p);
+    snap->lado = leU16(p + 8);
+    snap->semente = leU64(p + 10);
+    snap->linha = leU16(p + 18);
+    snap->coluna = leU16(p + 20);
+    snap->movimentos = leU32(p + 22);
+    if (palavras > 0) {
+        snap->reveladas = calloc(palavras, sizeof(uint64_t));
+        if (!snap->reveladas) {
+            free(snap);
+            return 0;
+        }
+        snap->palavras = palavras;
+    }
+    const uint8_t *q = p + CORPO_FIXO;
+    for (uint32_t k = 0; k < n; k++, q += PALAVRA_ESPARSA) {
+        uint32_t i = leU32(q);
+        if (i < palavras) snap->reveladas[i] = leU64(q + 4);
+    }
+    *saida = snap;
+    return 4 + corpo + 4;
+}
+
+static int escreveTudo(int fd, const uint8_t *dados, size_t tamanho) {
+    while (tamanho > 0) {
+        ssize_t n = write(fd, dados, tamanho);
+        if (n < 0) return -1;
+        dados += n;
+        tamanho -= n;
+    }
+    return 0;
+}
+
+void guardaSnapshot(Snapshot *snap) {
+    uint8_t *registro = NULL;
+    size_t tamanho = wal.ativo ? serializa(snap, &registro) : 0;
+    insere(snap, registro, tamanho);
+    free(registro);
+}
+
+// Troca o buffer cheio por um vazio e grava fora da trava: os workers nunca esperam o disco.
+// Chamado com a trava de escrita; retorna os bytes gravados
+static size_t descarregaWal(void) {
+    pthread_mutex_lock(&wal.trava);
+    size_t tamanho = wal.tamanho;
+    if (tamanho > 0) {
+        uint8_t *dados = wal.dados;
+        size_t capacidade = wal.capacidade;
+        wal.dados = wal.lote;
+        wal.capacidade = wal.capacidade_lote;
+        wal.tamanho = 0;
+        wal.lote = dados;
+        wal.capacidade_lote = capacidade;
+    }
+    pthread_mutex_unlock(&wal.trava);
+    if (tamanho == 0) return 0;
+
+    if (escreveTudo(wal.fd, wal.lote, tamanho) == -1 || fdatasync(wal.fd) == -1) {
+        perror("Erro ao gravar o WAL");
+    }
+    return tamanho;
+}
+
+// Grava todos os retratos da tabela em um arquivo novo que substitui o WAL de uma vez e
+// retorna o descritor dele, pronto para acrescentar, ou -1. Cada fatia é copiada sob a sua
+// trava; um registro acrescentado ao buffer enquanto isso vai para o arquivo novo depois e,
+// mesmo repetindo o que a cópia já pegou, não muda o resultado da releitura
+static int compactaWal(const char *arquivo, size_t *bytes) {
+    char temporario[4096];
+    snprintf(temporario, sizeof(temporario), "%s.tmp", arquivo);
+    int fd = open(temporario, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (fd == -1) return -1;
+
+    int resultado = 0;
+    uint8_t *copia = NULL;
+    size_t capacidade = 0;
+    *bytes = 0;
+    for (int f = 0; f < FATIAS && resultado == 0; f++) {
+        size_t tamanho_copia = 0;
+        pthread_mutex_lock(&fatias[f].trava);
+        for (int b = 0; b < BALDES_FATIA && resultado == 0; b++) {
+            for (Snapshot *snap = fatias[f].baldes[b]; snap; snap = snap->proximo) {
+                uint8_t *registro;
+                size_t tamanho = serializa(snap, &registro);
+                if (tamanho && tamanho_copia + tamanho > capacidade) {
+                    size_t nova = capacidade ? capacidade : 64 * 1024;
+                    while (nova < tamanho_copia + tamanho) nova *= 2;
+                    uint8_t *dados = realloc(copia, nova);
+                    if (dados) {
+                        copia = dados;
+                        capacidade = nova;
+                    }
+                }
+                if (!tamanho || tamanho_copia + tamanho > capacidade) resultado = -1;
+                else memcpy(copia + tamanho_copia, registro, tamanho);
+                if (tamanho) free(registro);
+                if (resultado == -1) break;
+                tamanho_copia += tamanho;
+            }
+        }
+        pthread_mutex_unlock(&fatias[f].trava);
+        if (resultado == 0 && escreveTudo(fd, copia, tamanho_copia) == -1) resultado = -1;
+        *bytes += tamanho_copia;
+    }
+    free(copia);
+    if (resultado == 0 && fsync(fd) == -1) resultado = -1;
+    if (resultado == 0 && rename(temporario, arquivo) == -1) resultado = -1;
+    if (resultado == -1) {
+        close(fd);
+        unlink(temporario);
+        return -1;
+    }
+    return fd;
+}
+
+// Os retratos periódicos das sessões conectadas fazem o arquivo crescer sem parar; quando o
+// acrescentado passa do tamanho da última compactação (e de WAL_COMPACTACAO), compacta de novo
+static void *loopWal(void *arg) {
+    (void)arg;
+    struct timespec espera = {0, WAL_INTERVALO_MS * 1000 * 1000};
+    size_t acrescentados = 0;
+    while (1) {
+        nanosleep(&espera, NULL);
+        pthread_mutex_lock(&wal.escrita);
+        acrescentados += descarregaWal();
+        if (encerrando) exit(EXIT_SUCCESS); // Com a trava: nada mais é gravado
+        if (acrescentados > WAL_COMPACTACAO && acrescentados > wal.compactado) {
+            size_t bytes;
+            int fd = compactaWal(wal.arquivo, &bytes);
+            if (fd != -1) {
+                close(wal.fd);
+                wal.fd = fd;
+                wal.compactado = bytes;
+            } else {
+                perror("Erro ao compactar o WAL");
+            }
+            acrescentados = 0;
+        }
+        pthread_mutex_unlock(&wal.escrita);
+    }
+    return NULL;
+}
+
+static void trataEncerramento(int sinal) {
+    (void)sinal;
+    encerrando = 1;
+}
+
+int iniciaWal(const char *arquivo) {
+    int fd = open(arquivo, O_RDONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (fd == -1) return -1;
+    struct stat info;
+    if (fstat(fd, &info) == -1) {
+        close(fd);
+        return -1;
+    }
+
+    size_t tamanho = (size_t)info.st_size, lidos = 0;
+    uint8_t *dados = malloc(tamanho ? tamanho : 1);
+    if (!dados) {
+        close(fd);
+        return -1;
+    }
+    while (lidos < tamanho) {
+        ssize_t n = read(fd, dados + lidos, tamanho - lidos);
+        if (n <= 0) break;
+        lidos += n;
+    }
+    close(fd);
+
+    // Registros posteriores substituem os anteriores do mesmo token e uma lápide o apaga. Um
+    // registro incompleto no fim (queda durante a gravação) encerra a leitura. A compactação
+    // em seguida só regrava o que sobrou na tabela, então as lápides não passam para o novo WAL
+    size_t pos = 0, registros = 0;
+    while (pos < lidos) {
+        Snapshot *snap;
+        uint64_t token;
+        size_t usado = desserializa(dados + pos, lidos - pos, &snap, &token);
+        if (usado == 0) {
+            fprintf(stderr, "WAL %s: registro inválido em %zu, descartando o restante\n", arquivo, pos);
+            break;
+        }
+        if (snap) insere(snap, NULL, 0);
+        else liberaSnapshot(retiraSnapshot(token)); // Sem WAL ativo ainda: não gera outra lápide
+        pos += usado;
+        registros++;
+    }
+    free(dados);
+    printf("WAL %s: %zu registros relidos\n", arquivo, registros);
+
+    wal.fd = compactaWal(arquivo, &wal.compactado);
+    if (wal.fd == -1) return -1;
+    wal.arquivo = arquivo;
+    wal.ativo = true;
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, loopWal, NULL) != 0) return -1;
+    pthread_detach(thread);
+
+    // O que os workers já entregaram chega ao disco antes de o processo sair
+    struct sigaction acao = {0};
+    acao.sa_handler = trataEncerramento;
+    acao.sa_flags = SA_RESTART;
+    sigemptyset(&acao.sa_mask);
+    if (sigaction(SIGTERM, &acao, NULL) == -1 || sigaction(SIGINT, &acao, NULL) == -1) return -1;
+    return 0;
+}
+
+bool walAtivo(void) {
+    return wal.ativo;
+}
@@ -0,0 +1,50 @@
+#ifndef PERSISTENCIA_H
+#define PERSISTENCIA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Retratos de partidas para retomar sessões pelo token. Ficam em uma tabela hash global
+// dividida em fatias com travas próprias e, com -w, também em um log de escrita antecipada
+// (WAL) gravado por uma thread própria e relido na partida do servidor. As sessões conectadas
+// guardam retratos periódicos, que só servem para a partida voltar depois de uma queda.
+
+typedef struct Snapshot {
+    uint64_t token;
+    uint16_t lado;     // Lado do labirinto gerado; 0 para o labirinto do arquivo
+    uint64_t semente;
+    uint16_t linha, coluna;
+    uint32_t movimentos;
+    uint64_t *reveladas; // Conjunto de células reveladas (pode ser NULL)
+    size_t palavras;     // Tamanho de `reveladas` em palavras de 64 bits
+    bool ativa;          // Retrato periódico de uma sessão conectada: não pode ser retomado
+    struct Snapshot *proximo;
+} Snapshot;
+
+// Token aleatório e não nulo
+uint64_t novoToken(void);
+
+// Guarda o retrato, substituindo outro com o mesmo token, e o acrescenta ao WAL.
+// A tabela passa a ser dona do retrato
+void guardaSnapshot(Snapshot *snap);
+
+// Tira o retrato da tabela (a sessão que retoma passa a ser dona dele) ou retorna NULL,
+// também se ele é de uma sessão conectada.
+// Com o WAL ativo grava uma lápide, para a partida retomada não voltar ao reiniciar
+Snapshot *retiraSnapshot(uint64_t token);
+
+// Lado e semente do retrato guardado sob `token`, sem tirá-lo da tabela. Retorna false se não há
+bool consultaSnapshot(uint64_t token, uint16_t *lado, uint64_t *semente);
+
+void liberaSnapshot(Snapshot *snap);
+
+// Relê o WAL para a tabela, reescreve-o compactado e inicia a thread de gravação, que também
+// o compacta de tempos em tempos. SIGTERM e SIGINT passam a gravar o buffer pendente antes de
+// sair. Retorna -1 se o arquivo não pôde ser aberto
+int iniciaWal(const char *arquivo);
+
+// Com -w: vale a pena guardar retratos periódicos das sessões conectadas
+bool walAtivo(void);
+
+#endif
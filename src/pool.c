@@ -0,0 +1,97 @@
+#include <stdlib.h>
+
+#include "pool.h"
+
+static void publica(EstatisticasPool *e, uint64_t em_uso, uint64_t maximo, uint64_t capacidade) {
+    if (!e) return;
+    atomic_store_explicit(&e->em_uso, em_uso, memory_order_relaxed);
+    atomic_store_explicit(&e->maximo, maximo, memory_order_relaxed);
+    atomic_store_explicit(&e->capacidade, capacidade, memory_order_relaxed);
+}
+
+void iniciaPool(Pool *pool, size_t tamanho, size_t por_bloco, EstatisticasPool *estatisticas) {
+    pool->tamanho = (tamanho + 63) & ~(size_t)63;
+    pool->por_bloco = por_bloco;
+    pool->livres = NULL;
+    pool->em_uso = pool->maximo = pool->capacidade = 0;
+    pool->estatisticas = estatisticas;
+}
+
+void *poolAloca(Pool *pool) {
+    if (!pool->livres) {
+        uint8_t *bloco = aligned_alloc(64, pool->tamanho * pool->por_bloco);
+        if (!bloco) return NULL;
+        for (size_t i = pool->por_bloco; i-- > 0;) {
+            void *objeto = bloco + i * pool->tamanho;
+            *(void **)objeto = pool->livres;
+            pool->livres = objeto;
+        }
+        pool->capacidade += pool->por_bloco;
+    }
+    void *objeto = pool->livres;
+    pool->livres = *(void **)objeto;
+    if (++pool->em_uso > pool->maximo) pool->maximo = pool->em_uso;
+    publica(pool->estatisticas, pool->em_uso, pool->maximo, pool->capacidade);
+    return objeto;
+}
+
+void poolLibera(Pool *pool, void *objeto) {
+    *(void **)objeto = pool->livres;
+    pool->livres = objeto;
+    pool->em_uso--;
+    publica(pool->estatisticas, pool->em_uso, pool->maximo, pool->capacidade);
+}
+
+static BlocoArena *novoBloco(size_t capacidade, BlocoArena *anterior) {
+    BlocoArena *bloco = malloc(sizeof(BlocoArena) + capacidade);
+    if (!bloco) return NULL;
+    bloco->anterior = anterior;
+    bloco->capacidade = capacidade;
+    bloco->usado = 0;
+    return bloco;
+}
+
+void iniciaArena(Arena *arena, size_t capacidade, EstatisticasPool *estatisticas) {
+    arena->atual = novoBloco(capacidade, NULL);
+    arena->usado = arena->maximo = 0;
+    arena->capacidade = arena->atual ? capacidade : 0;
+    arena->estatisticas = estatisticas;
+}
+
+void *arenaAloca(Arena *arena, size_t tamanho) {
+    tamanho = (tamanho + 15) & ~(size_t)15;
+    BlocoArena *bloco = arena->atual;
+    if (!bloco || bloco->capacidade - bloco->usado < tamanho) {
+        size_t capacidade = bloco ? bloco->capacidade * 2 : 64 * 1024;
+        if (capacidade < tamanho) capacidade = tamanho;
+        bloco = novoBloco(capacidade, arena->atual);
+        if (!bloco) return NULL;
+        arena->atual = bloco;
+        arena->capacidade += capacidade;
+    }
+    void *p = bloco->dados + bloco->usado;
+    bloco->usado += tamanho;
+    arena->usado += tamanho;
+    if (arena->usado > arena->maximo) arena->maximo = arena->usado;
+    return p;
+}
+
+void arenaReinicia(Arena *arena) {
+    BlocoArena *bloco = arena->atual;
+    if (bloco && bloco->anterior) {
+        // O pedido passou do bloco: troca a cadeia por um bloco que comporta o maior pedido,
+        // até ARENA_RETIDA; pedidos maiores que isso voltam a encadear blocos e os devolvem aqui
+        while (bloco) {
+            BlocoArena *anterior = bloco->anterior;
+            free(bloco);
+            bloco = anterior;
+        }
+        size_t capacidade = arena->maximo < ARENA_RETIDA ? arena->maximo : ARENA_RETIDA;
+        arena->atual = novoBloco(capacidade, NULL);
+        arena->capacidade = arena->atual ? capacidade : 0;
+    } else if (bloco) {
+        bloco->usado = 0;
+    }
+    arena->usado = 0;
+    publica(arena->estatisticas, arena->usado, arena->maximo, arena->capacidade);
+}
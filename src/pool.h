@@ -0,0 +1,46 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "metricas.h"
+
+// Alocadores de um único worker (sem travas). Depois do aquecimento nenhum dos dois chama
+// malloc: o pool reaproveita objetos liberados e a arena reaproveita o mesmo bloco a cada pedido.
+
+// Pool de objetos de tamanho fixo, alocados em blocos (slabs) que nunca voltam ao sistema.
+// Objetos livres formam uma lista encadeada guardada neles mesmos
+typedef struct {
+    size_t tamanho;   // Bytes por objeto, múltiplo de 64 (uma linha de cache)
+    size_t por_bloco; // Objetos por slab
+    void *livres;
+    uint64_t em_uso, maximo, capacidade;
+    EstatisticasPool *estatisticas; // Cópia das contagens para a thread de métricas (pode ser NULL)
+} Pool;
+
+void iniciaPool(Pool *pool, size_t tamanho, size_t por_bloco, EstatisticasPool *estatisticas);
+void *poolAloca(Pool *pool); // NULL sem memória
+void poolLibera(Pool *pool, void *objeto);
+
+// Arena de rascunho de um pedido: alocação por incremento de ponteiro e descarte de tudo de
+// uma vez no fim do pedido. Se um pedido não couber, blocos extras são encadeados e, no
+// reinício, trocados por um único bloco do tamanho total, limitado a ARENA_RETIDA
+#define ARENA_RETIDA (16u << 20) // Cobre a dica de um labirinto de lado 1025 com qualquer motor
+typedef struct BlocoArena {
+    struct BlocoArena *anterior;
+    size_t capacidade, usado;
+    _Alignas(16) uint8_t dados[];
+} BlocoArena;
+
+typedef struct {
+    BlocoArena *atual;
+    uint64_t usado, maximo, capacidade;
+    EstatisticasPool *estatisticas;
+} Arena;
+
+void iniciaArena(Arena *arena, size_t capacidade, EstatisticasPool *estatisticas);
+void *arenaAloca(Arena *arena, size_t tamanho); // Alinhado a 16 bytes; NULL sem memória
+void arenaReinicia(Arena *arena);
+
+#endif
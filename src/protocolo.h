@@ -0,0 +1,159 @@
+#ifndef PROTOCOLO_H
+#define PROTOCOLO_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Protocolo binário compartilhado entre cliente e servidor.
+//
+// Cada mensagem é um quadro: [versão u8][opcode u8][tamanho u32 big-endian]
+// seguido de `tamanho` bytes de carga. Inteiros da carga também são big-endian.
+// O cliente pode enviar vários pedidos sem esperar as respostas: o servidor trata os
+// quadros na ordem em que chegam e responde na mesma ordem.
+//
+// Cargas por opcode:
+//   ACTION_HINT, ACTION_RESET, ACTION_EXIT: vazia (pedido)
+//   ACTION_START  (pedido): vazia para o labirinto do servidor, ou u16 lado e u64 semente para
+//       um labirinto gerado (INICIO_GERADO bytes), com o jogador na entrada. Acima dos limites
+//       do servidor (-G) o jogador continua no labirinto em que estava
+//   ACTION_MOVE   (pedido): u8 direção (1 cima, 2 direita, 3 baixo, 4 esquerda)
+//   ACTION_MAP    (pedido): vazia ou u8 modo (MAPA_COMPLETO, MAPA_INCREMENTAL)
+//   ACTION_UPDATE (resposta): u8 máscara de movimentos válidos (MOVIMENTO_BIT)
+//   ACTION_MAP, ACTION_WIN (resposta): u16 linhas, u16 colunas, células em nibbles
+//   ACTION_MAP_DELTA (resposta a MAPA_INCREMENTAL): u16 linhas, u16 colunas,
+//       u16 linha e u16 coluna do jogador, u16 n, e n células novas (u16 linha, u16 coluna, u8 tipo)
+//   ACTION_HINT   (resposta): u32 passos, direções com 2 bits cada
+//   ACTION_MOVE_BATCH (pedido): u16 n, direções com 2 bits cada; aplicadas em ordem até a
+//       primeira parede ou até a saída. Sem a contagem, a resposta tem 0 passos aplicados
+//   ACTION_MOVED  (resposta a ACTION_MOVE_BATCH): u16 passos aplicados, u16 linha, u16 coluna,
+//       u8 máscara de movimentos válidos, u8 1 se o jogador chegou à saída
+//   ACTION_TOKEN  (pedido): vazia; (resposta): u64 token da sessão, criado no primeiro pedido.
+//       Ao desconectar, a partida de uma sessão com token é guardada para ser retomada; com -w
+//       também vai ao WAL a cada segundo com mudanças, para voltar depois de uma queda
+//   ACTION_RESUME (pedido): u64 token; (resposta): u8 1 se retomou, u16 linhas, u16 colunas,
+//       u16 linha, u16 coluna, u32 movimentos, u8 máscara de movimentos válidos
+//   ACTION_JOIN   (pedido): u32 sala e u8 papel (SALA_JOGADOR, SALA_ESPECTADOR), opcionalmente
+//       seguidos de u16 lado e u64 semente do labirinto, usados só por quem cria a sala. A sala 0
+//       só tira a sessão da sala atual. START e RESUME também saem da sala
+//   ACTION_ROOM   (resposta a ACTION_JOIN): u32 sala, u16 linhas, u16 colunas, u16 id do jogador
+//       (SALA_SEM_ID para espectadores), u16 n e n jogadores (u16 id, u16 linha, u16 coluna).
+//       Vazia se não foi possível entrar (ou depois de sair); nesse caso a partida atual continua
+//   ACTION_ROOM_DELTA (enviado sem pedido a todos da sala): u32 sala, u16 n e n jogadores
+//       (u16 id, u16 linha, u16 coluna) que mudaram desde o último; linha SALA_SEM_ID quando o
+//       jogador saiu. Um espectador atrasado demais perde quadros e recebe um ACTION_ROOM novo
+
+#define PROTOCOLO_VERSAO 1
+#define CABECALHO_TAMANHO 6
+#define MAX_CARGA_PEDIDO 1024 // Maior carga aceita do cliente
+
+// Tipos de ações (opcodes)
+#define ACTION_START 0
+#define ACTION_MOVE 1
+#define ACTION_MAP 2
+#define ACTION_HINT 3
+#define ACTION_UPDATE 4
+#define ACTION_WIN 5
+#define ACTION_RESET 6
+#define ACTION_EXIT 7
+#define ACTION_MAP_DELTA 8
+#define ACTION_MOVE_BATCH 9
+#define ACTION_MOVED 10
+#define ACTION_TOKEN 11
+#define ACTION_RESUME 12
+#define ACTION_JOIN 13
+#define ACTION_ROOM 14
+#define ACTION_ROOM_DELTA 15
+
+#define MAX_PASSOS_LOTE ((MAX_CARGA_PEDIDO - 2) * 4) // Direções por ACTION_MOVE_BATCH
+#define MOVIDO_TAMANHO 8                              // Carga de ACTION_MOVED
+#define INICIO_GERADO 10                              // Carga de ACTION_START com lado e semente
+#define RETOMADA_TAMANHO 14                           // Carga da resposta de ACTION_RESUME
+#define ENTRADA_SALA 5                                // Carga mínima de ACTION_JOIN
+
+// Salas
+#define SALA_JOGADOR 0
+#define SALA_ESPECTADOR 1
+#define SALA_SEM_ID 0xFFFF
+#define SALA_CABECALHO 12 // Sala, dimensões, id e contagem de ACTION_ROOM
+#define SALA_DELTA_CABECALHO 6 // Sala e contagem de ACTION_ROOM_DELTA
+#define SALA_JOGADOR_TAMANHO 6 // Bytes por jogador nos dois quadros
+
+// Modos de ACTION_MAP
+#define MAPA_COMPLETO 0    // Tabuleiro inteiro: janela do jogador e células já reveladas, o resto UNKNOWN
+#define MAPA_INCREMENTAL 1 // Só as células reveladas pela primeira vez nesta partida
+// As reveladas recomeçam vazias em todo ACTION_START, ACTION_RESET e ACTION_JOIN que entra na
+// sala, e o cliente descarta o seu mapa nos mesmos pedidos. ACTION_RESUME traz as da partida
+// guardada, e um ACTION_JOIN recusado mantém as da partida atual: nos dois casos o cliente
+// descarta o seu mapa e pede um MAPA_COMPLETO para reconstruí-lo
+
+#define DELTA_CABECALHO 10 // Dimensões, posição do jogador e contagem
+#define DELTA_CELULA 5     // Bytes por célula de ACTION_MAP_DELTA
+
+// Bit da máscara de movimentos para a direção d (1..4)
+#define MOVIMENTO_BIT(d) (1u << ((d) - 1))
+
+static inline void escreveU16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+static inline void escreveU32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static inline void escreveU64(uint8_t *p, uint64_t v) {
+    escreveU32(p, (uint32_t)(v >> 32));
+    escreveU32(p + 4, (uint32_t)v);
+}
+
+static inline uint16_t leU16(const uint8_t *p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static inline uint32_t leU32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline uint64_t leU64(const uint8_t *p) {
+    return ((uint64_t)leU32(p) << 32) | leU32(p + 4);
+}
+
+static inline void escreveCabecalho(uint8_t *p, uint8_t opcode, uint32_t tamanho) {
+    p[0] = PROTOCOLO_VERSAO;
+    p[1] = opcode;
+    escreveU32(p + 2, tamanho);
+}
+
+// Bytes necessários para `passos` direções de 2 bits
+static inline size_t tamanhoDirecoes(size_t passos) {
+    return (passos + 3) / 4;
+}
+
+// Grava a direção (1..4) do passo i; o primeiro passo ocupa os bits altos do byte
+static inline void empacotaDirecao(uint8_t *p, size_t i, int direcao) {
+    int deslocamento = 6 - 2 * (int)(i % 4);
+    p[i / 4] = (uint8_t)((p[i / 4] & ~(3 << deslocamento)) | ((direcao - 1) << deslocamento));
+}
+
+static inline int desempacotaDirecao(const uint8_t *p, size_t i) {
+    return ((p[i / 4] >> (6 - 2 * (i % 4))) & 3) + 1;
+}
+
+// Bytes necessários para um tabuleiro de células em nibbles
+static inline size_t tamanhoTabuleiro(size_t linhas, size_t colunas) {
+    return 4 + (linhas * colunas + 1) / 2;
+}
+
+static inline void empacotaCelula(uint8_t *celulas, size_t i, int valor) {
+    if (i % 2 == 0) celulas[i / 2] = (uint8_t)((celulas[i / 2] & 0x0F) | (valor << 4));
+    else celulas[i / 2] = (uint8_t)((celulas[i / 2] & 0xF0) | (valor & 0x0F));
+}
+
+static inline int desempacotaCelula(const uint8_t *celulas, size_t i) {
+    return (i % 2 == 0) ? celulas[i / 2] >> 4 : celulas[i / 2] & 0x0F;
+}
+
+#endif
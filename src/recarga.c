@@ -0,0 +1,184 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <time.h>
+
+#include "recarga.h"
+#include "metricas.h"
+#include "sessao.h"
+
+typedef struct VersaoLabirinto {
+    Labirinto lab; // Primeiro membro: o ponteiro do labirinto é o da versão
+    _Atomic uint32_t referencias; // Sessões, salas e a publicação, enquanto é a atual
+    uint32_t numero;
+    struct VersaoLabirinto *proxima_retirada;
+} VersaoLabirinto;
+
+// Contador por worker, cada um na sua linha de cache: ímpar dentro de uma volta
+typedef struct {
+    _Atomic uint64_t contador;
+    char preenchimento[64 - sizeof(uint64_t)];
+} Epoca;
+
+static Epoca epocas[MAX_WORKERS];
+static _Thread_local Epoca *epoca_thread;
+
+static _Atomic(VersaoLabirinto *) atual;
+static _Atomic(VersaoLabirinto *) retiradas; // Sem referências, esperando a thread de recarga
+static char *arquivo_labirinto;
+static sem_t pedidos;
+static _Atomic uint64_t recargas, falhas;
+static _Atomic uint32_t numero_atual; // Lido pelas métricas, que não seguram referência
+
+void registraEpoca(int worker) {
+    epoca_thread = &epocas[worker];
+}
+
+// O incremento de entrada precisa ser visto antes da leitura do ponteiro (seq_cst); o de
+// saída só depois de tudo o que a volta leu (release)
+void entraVolta(void) {
+    Epoca *e = epoca_thread;
+    atomic_store_explicit(&e->contador, atomic_load_explicit(&e->contador, memory_order_relaxed) + 1, memory_order_seq_cst);
+}
+
+void saiVolta(void) {
+    Epoca *e = epoca_thread;
+    atomic_store_explicit(&e->contador, atomic_load_explicit(&e->contador, memory_order_relaxed) + 1, memory_order_release);
+}
+
+// Volta quando cada worker que estava dentro de uma volta saiu dela (ou entrou em outra)
+static void esperaQuiescencia(void) {
+    uint64_t vistos[MAX_WORKERS];
+    for (int w = 0; w < MAX_WORKERS; w++) vistos[w] = atomic_load(&epocas[w].contador);
+    struct timespec espera = {0, 100 * 1000};
+    for (int w = 0; w < MAX_WORKERS; w++) {
+        while ((vistos[w] & 1) && atomic_load(&epocas[w].contador) == vistos[w]) nanosleep(&espera, NULL);
+    }
+}
+
+const Labirinto *obtemLabirintoAtual(void) {
+    VersaoLabirinto *v = atomic_load(&atual);
+    atomic_fetch_add_explicit(&v->referencias, 1, memory_order_relaxed);
+    return &v->lab;
+}
+
+bool labirintoSubstituido(const Labirinto *versao) {
+    return atomic_load_explicit(&atual, memory_order_relaxed) != (const VersaoLabirinto *)versao;
+}
+
+void retemLabirinto(const Labirinto *versao) {
+    VersaoLabirinto *v = (VersaoLabirinto *)versao;
+    atomic_fetch_add_explicit(&v->referencias, 1, memory_order_relaxed);
+}
+
+void devolveLabirinto(const Labirinto *versao) {
+    VersaoLabirinto *v = (VersaoLabirinto *)versao;
+    if (atomic_fetch_sub_explicit(&v->referencias, 1, memory_order_acq_rel) != 1) return;
+    VersaoLabirinto *cabeca = atomic_load_explicit(&retiradas, memory_order_relaxed);
+    do {
+        v->proxima_retirada = cabeca;
+    } while (!atomic_compare_exchange_weak_explicit(&retiradas, &cabeca, v, memory_order_release, memory_order_relaxed));
+}
+
+static void liberaRetiradas(void) {
+    VersaoLabirinto *v = atomic_exchange_explicit(&retiradas, NULL, memory_order_acquire);
+    while (v) {
+        VersaoLabirinto *seguinte = v->proxima_retirada;
+        registraLog("versão %u do labirinto liberada\n", v->numero);
+        liberaLabirinto(&v->lab);
+        free(v);
+        v = seguinte;
+    }
+}
+
+static VersaoLabirinto *carregaVersao(void) {
+    VersaoLabirinto *v = calloc(1, sizeof(VersaoLabirinto));
+    if (!v) return NULL;
+    if (carregaLabirinto(arquivo_labirinto, &v->lab) == -1) {
+        free(v);
+        return NULL;
+    }
+    atomic_init(&v->referencias, 1);
+    return v;
+}
+
+int carregaVersaoInicial(const char *arquivo) {
+    arquivo_labirinto = strdup(arquivo);
+    VersaoLabirinto *v = arquivo_labirinto ? carregaVersao() : NULL;
+    if (!v) return -1;
+    v->numero = 1;
+    atomic_store(&atual, v);
+    atomic_store(&numero_atual, 1);
+    return 0;
+}
+
+// Monta a versão nova fora de qualquer volta, publica e solta a antiga depois da quiescência
+static void recarrega(void) {
+    uint64_t comeco = agoraNs();
+    VersaoLabirinto *nova = carregaVersao();
+    if (!nova) {
+        atomic_fetch_add(&falhas, 1);
+        registraLog("Recarga de %s falhou; a versão anterior continua\n", arquivo_labirinto);
+        return;
+    }
+    VersaoLabirinto *antiga = atomic_load(&atual);
+    nova->numero = antiga->numero + 1;
+    atomic_store(&atual, nova);
+    atomic_store(&numero_atual, nova->numero);
+    esperaQuiescencia();
+    devolveLabirinto(&antiga->lab);
+    atomic_fetch_add(&recargas, 1);
+    registraLog("labirinto %s recarregado (versão %u, %dx%d) em %.1f ms\n", arquivo_labirinto, nova->numero,
+                nova->lab.linhas, nova->lab.colunas, (agoraNs() - comeco) / 1e6);
+}
+
+// Pedidos acumulados viram uma recarga só; sem pedidos, a cada segundo libera as versões
+// que perderam a última referência
+static void *loopRecarga(void *arg) {
+    (void)arg;
+    while (1) {
+        struct timespec limite;
+        clock_gettime(CLOCK_REALTIME, &limite);
+        limite.tv_sec += 1;
+        bool pedida = sem_timedwait(&pedidos, &limite) == 0;
+        while (sem_trywait(&pedidos) == 0) pedida = true; // Inclui o que chegou com EINTR
+        if (pedida) recarrega();
+        liberaRetiradas();
+    }
+    return NULL;
+}
+
+void pedeRecarga(void) {
+    sem_post(&pedidos);
+}
+
+static void trataSighup(int sinal) {
+    (void)sinal;
+    pedeRecarga();
+}
+
+int iniciaRecarga(void) {
+    if (sem_init(&pedidos, 0, 0) == -1) return -1;
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, loopRecarga, NULL) != 0) return -1;
+    pthread_detach(thread);
+
+    struct sigaction acao = {0};
+    acao.sa_handler = trataSighup;
+    acao.sa_flags = SA_RESTART;
+    sigemptyset(&acao.sa_mask);
+    return sigaction(SIGHUP, &acao, NULL);
+}
+
+EstatisticasRecarga estatisticasRecarga(void) {
+    EstatisticasRecarga e;
+    e.versao = atomic_load(&numero_atual);
+    e.recargas = atomic_load(&recargas);
+    e.falhas = atomic_load(&falhas);
+    return e;
+}
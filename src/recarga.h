@@ -0,0 +1,49 @@
+#ifndef RECARGA_H
+#define RECARGA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "labirinto.h"
+
+// Labirinto do arquivo (-i) recarregável com o servidor no ar. SIGHUP, ou POST /recarrega na
+// porta de métricas, faz uma thread própria reler o arquivo e montar as tabelas; a versão nova
+// é publicada com a troca de um ponteiro. Sessões novas e as que recomeçam (START sem carga,
+// RESET) passam para ela; as outras continuam na versão que tinham.
+//
+// Cada sessão, e cada sala no labirinto do arquivo, guarda uma referência à sua versão. O
+// ponteiro da versão atual só é lido dentro de uma volta do laço de eventos, e a referência da
+// publicação só é solta depois que todos os workers passaram por fora de uma volta, como no
+// RCU: quem leu o ponteiro antigo já pegou a sua referência. Os workers não usam travas, e a
+// versão que perde a última referência é liberada pela thread de recarga, não pelo worker.
+
+// Primeira versão, carregada antes dos workers
+int carregaVersaoInicial(const char *arquivo);
+// Cria a thread de recarga e instala o tratador de SIGHUP
+int iniciaRecarga(void);
+// Pede uma recarga; pode ser chamado de um tratador de sinal
+void pedeRecarga(void);
+
+// Versão atual, com uma referência nova. Só dentro de uma volta (ou antes dos workers)
+const Labirinto *obtemLabirintoAtual(void);
+// Se já existe uma versão mais nova que `versao`; não pega referência
+bool labirintoSubstituido(const Labirinto *versao);
+// Outra referência a uma versão da qual já se tem uma
+void retemLabirinto(const Labirinto *versao);
+void devolveLabirinto(const Labirinto *versao);
+
+// Cada worker marca a entrada e a saída das suas voltas; fora delas não guarda ponteiros
+// lidos sem referência
+void registraEpoca(int worker);
+void entraVolta(void);
+void saiVolta(void);
+
+typedef struct {
+    uint32_t versao;  // 1 para a versão carregada na partida
+    uint64_t recargas;
+    uint64_t falhas;  // Arquivo que não carregou; a versão anterior continua
+} EstatisticasRecarga;
+
+EstatisticasRecarga estatisticasRecarga(void);
+
+#endif
@@ -0,0 +1,589 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <netdb.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#include "protocolo.h"
+#include "gravacao.h"
+
+// Reprodução de uma gravação do servidor (server -r): uma conexão por sessão gravada, com os
+// pedidos de cada uma reenviados no ritmo original, mais rápido (-x 2, -x 10...) ou sem
+// esperar (-x 0). Cada resposta é comparada com o resumo gravado (quadros e soma), então a
+// mesma gravação serve de teste de regressão (termina com erro se algo divergir) e de
+// benchmark com uma carga real. Tokens de RESUME são trocados pelos que o servidor novo
+// entregou, e um RESUME só é enviado depois que a sessão dona do token fechou.
+// Uso: replay <gravacao> <endereco> <porta> [-x velocidade] [-p profundidade] [-v]
+
+#define MAX_EVENTOS 512
+#define LOTE_ENVIO 65536
+#define DIVERGENCIAS_MOSTRADAS 20
+#define INATIVIDADE_MAXIMA_NS (10ull * 1000000000ull) // Sem nenhuma resposta: servidor parado
+
+typedef struct {
+    uint8_t tipo, opcode;
+    uint16_t quadros;
+    uint32_t sessao, bytes, tamanho;
+    uint64_t instante, soma, token;
+    const uint8_t *carga;
+} Registro;
+
+#define ESPERANDO 0 // Primeiro pedido ainda não chegou
+#define CONECTANDO 1
+#define ABERTA 2
+#define FECHANDO 3  // shutdown enviado, esperando o servidor fechar
+#define FECHADA 4
+
+typedef struct {
+    int socket;
+    int estado;
+    size_t *registros; // Índices dos registros da sessão, em ordem
+    size_t num, capacidade;
+    size_t liberados;   // Registros cujo instante já chegou
+    size_t enviados;    // Próximo registro a enviar
+    size_t respondidos; // Próximo pedido esperando resposta
+    uint16_t quadros;   // Da resposta em andamento
+    uint64_t soma, token;
+    uint8_t *resposta;
+    size_t recebidos, capacidade_resposta;
+    bool pronta, esperando_token;
+} SessaoReplay;
+
+// Tokens entregues nas respostas gravadas, em ordem, com o token que o servidor novo deu
+// no lugar e a última sessão que o usou
+typedef struct {
+    uint64_t gravado, novo;
+    uint32_t dona;
+} Token;
+
+static Registro *registros;
+static size_t num_registros;
+static SessaoReplay *sessoes; // Índice = número da sessão na gravação
+static uint32_t num_sessoes;
+static Token *tokens;
+static size_t num_tokens;
+static uint64_t *enviado_em;
+static int epoll_fd, profundidade = 16, detalhado;
+static uint32_t *prontas;
+static size_t num_prontas;
+static uint64_t iguais, divergencias, erros, ultima_resposta;
+static size_t num_esperando; // Sessões com um RESUME esperando a dona do token fechar
+
+static const char *nomes_opcodes[16] = {"start", "move", "map", "hint", "update", "win", "reset", "exit",
+                                        "map_delta", "move_batch", "moved", "token", "resume", "join", "room", "room_delta"};
+
+// Histograma log-linear de latência por opcode (mesmo desenho do bin/carga)
+#define SUBFAIXAS 16
+#define FAIXAS 40
+
+typedef struct {
+    uint64_t contagem[FAIXAS * SUBFAIXAS];
+    uint64_t total, maximo;
+} Histograma;
+
+static Histograma histogramas[16];
+
+static int faixaHistograma(uint64_t ns) {
+    if (ns < SUBFAIXAS) return (int)ns;
+    int bits = 63 - __builtin_clzll(ns);
+    int indice = (bits - 3) * SUBFAIXAS + (int)((ns >> (bits - 4)) & (SUBFAIXAS - 1));
+    return indice < FAIXAS * SUBFAIXAS ? indice : FAIXAS * SUBFAIXAS - 1;
+}
+
+static uint64_t percentil(const Histograma *h, double p) {
+    uint64_t alvo = (uint64_t)(p * h->total), acumulado = 0;
+    if (alvo >= h->total) alvo = h->total - 1;
+    for (int i = 0; i < FAIXAS * SUBFAIXAS; i++) {
+        acumulado += h->contagem[i];
+        if (acumulado > alvo) {
+            int faixa = i / SUBFAIXAS, sub = i % SUBFAIXAS;
+            uint64_t v = faixa == 0 ? (uint64_t)sub : ((uint64_t)(SUBFAIXAS + sub + 1)) << (faixa - 1);
+            return v < h->maximo ? v : h->maximo;
+        }
+    }
+    return h->maximo;
+}
+
+static uint64_t agoraNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int comparaTokens(const void *a, const void *b) {
+    uint64_t x = ((const Token *)a)->gravado, y = ((const Token *)b)->gravado;
+    return x < y ? -1 : x > y;
+}
+
+static Token *buscaToken(uint64_t gravado) {
+    Token chave = {.gravado = gravado};
+    return bsearch(&chave, tokens, num_tokens, sizeof(Token), comparaTokens);
+}
+
+// Lê o arquivo inteiro e separa os registros por sessão. Retorna -1 se o arquivo é inválido
+static int carregaGravacao(const char *arquivo, uint64_t *inicio_parede) {
+    int fd = open(arquivo, O_RDONLY | O_CLOEXEC);
+    struct stat info;
+    if (fd == -1 || fstat(fd, &info) == -1) {
+        perror(arquivo);
+        return -1;
+    }
+    size_t tamanho = (size_t)info.st_size, lidos = 0;
+    uint8_t *dados = malloc(tamanho ? tamanho : 1);
+    while (dados && lidos < tamanho) {
+        ssize_t n = read(fd, dados + lidos, tamanho - lidos);
+        if (n <= 0) break;
+        lidos += n;
+    }
+    close(fd);
+    if (!dados || lidos < GRAVACAO_CABECALHO || memcmp(dados, MAGICA_GRAVACAO, 8) != 0) {
+        fprintf(stderr, "%s: não é uma gravação do servidor\n", arquivo);
+        return -1;
+    }
+    *inicio_parede = leU64(dados + 8);
+
+    // Primeira passada: contar e validar; um registro incompleto no fim é ignorado
+    size_t pos = GRAVACAO_CABECALHO, capacidade = 0;
+    while (pos + 4 <= lidos) {
+        size_t corpo = leU32(dados + pos);
+        if (corpo < REGISTRO_FIXO || pos + 4 + corpo > lidos) break;
+        const uint8_t *p = dados + pos + 4;
+        if (p[0] == REGISTRO_PEDIDO && corpo < REGISTRO_FIXO + PEDIDO_FIXO) break;
+        if (num_registros == capacidade) {
+            capacidade = capacidade ? capacidade * 2 : 4096;
+            registros = realloc(registros, capacidade * sizeof(Registro));
+            if (!registros) return -1;
+        }
+        Registro *r = &registros[num_registros++];
+        memset(r, 0, sizeof(*r));
+        r->tipo = p[0];
+        r->sessao = leU32(p + 1);
+        r->instante = leU64(p + 5);
+        if (r->tipo == REGISTRO_PEDIDO) {
+            p += REGISTRO_FIXO;
+            r->opcode = p[0];
+            r->quadros = leU16(p + 1);
+            r->bytes = leU32(p + 3);
+            r->soma = leU64(p + 7);
+            r->token = leU64(p + 15);
+            r->carga = p + PEDIDO_FIXO;
+            r->tamanho = (uint32_t)(corpo - REGISTRO_FIXO - PEDIDO_FIXO);
+            if (r->token) num_tokens++;
+        }
+        if (r->sessao > num_sessoes) num_sessoes = r->sessao;
+        pos += 4 + corpo;
+    }
+    if (pos < lidos) fprintf(stderr, "%s: %zu bytes finais ignorados (registro incompleto)\n", arquivo, lidos - pos);
+
+    sessoes = calloc((size_t)num_sessoes + 1, sizeof(SessaoReplay));
+    tokens = calloc(num_tokens ? num_tokens : 1, sizeof(Token));
+    enviado_em = calloc(num_registros ? num_registros : 1, sizeof(uint64_t));
+    prontas = malloc(((size_t)num_sessoes + 1) * sizeof(uint32_t));
+    if (!sessoes || !tokens || !enviado_em || !prontas) return -1;
+    num_tokens = 0;
+    for (size_t i = 0; i < num_registros; i++) {
+        SessaoReplay *s = &sessoes[registros[i].sessao];
+        if (s->num == s->capacidade) {
+            s->capacidade = s->capacidade ? s->capacidade * 2 : 16;
+            s->registros = realloc(s->registros, s->capacidade * sizeof(size_t));
+            if (!s->registros) return -1;
+        }
+        s->registros[s->num++] = i;
+        if (registros[i].token) tokens[num_tokens++].gravado = registros[i].token;
+    }
+
+    // Tokens repetidos (TOKEN pedido de novo, ou depois de um RESUME) ficam uma vez só
+    qsort(tokens, num_tokens, sizeof(Token), comparaTokens);
+    size_t unicos = 0;
+    for (size_t i = 0; i < num_tokens; i++) {
+        if (unicos == 0 || tokens[unicos - 1].gravado != tokens[i].gravado) tokens[unicos++] = tokens[i];
+    }
+    num_tokens = unicos;
+    // Até ser retomado, o token pertence à sessão que o recebeu primeiro
+    for (size_t i = 0; i < num_registros; i++) {
+        Token *t = registros[i].token ? buscaToken(registros[i].token) : NULL;
+        if (t && !t->dona) t->dona = registros[i].sessao;
+    }
+    return 0;
+}
+
+static int comparaInstantes(const void *a, const void *b) {
+    const Registro *x = &registros[*(const size_t *)a], *y = &registros[*(const size_t *)b];
+    if (x->instante != y->instante) return x->instante < y->instante ? -1 : 1;
+    return *(const size_t *)a < *(const size_t *)b ? -1 : 1; // Mantém a ordem do arquivo
+}
+
+static void marcaPronta(uint32_t id) {
+    if (sessoes[id].pronta) return;
+    sessoes[id].pronta = true;
+    prontas[num_prontas++] = id;
+}
+
+static void fechaSessao(uint32_t id) {
+    SessaoReplay *s = &sessoes[id];
+    if (s->estado == FECHADA) return;
+    if (s->socket > 0) close(s->socket);
+    s->socket = -1;
+    s->estado = FECHADA;
+    // Algum RESUME pode estar esperando esta sessão
+    for (uint32_t i = 1; num_esperando > 0 && i <= num_sessoes; i++) {
+        if (sessoes[i].esperando_token) {
+            sessoes[i].esperando_token = false;
+            num_esperando--;
+            marcaPronta(i);
+        }
+    }
+}
+
+static void falha(uint32_t id, const char *motivo) {
+    SessaoReplay *s = &sessoes[id];
+    erros++;
+    if (detalhado || erros <= DIVERGENCIAS_MOSTRADAS) {
+        fprintf(stderr, "sessão %u: %s (%zu de %zu pedidos respondidos)\n", id, motivo, s->respondidos, s->num);
+    }
+    fechaSessao(id);
+}
+
+static int conecta(uint32_t id, const struct sockaddr_storage *addr, socklen_t addr_len) {
+    SessaoReplay *s = &sessoes[id];
+    s->socket = socket(addr->ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (s->socket == -1) return -1;
+    int flag = 1;
+    setsockopt(s->socket, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+    if (connect(s->socket, (const struct sockaddr *)addr, addr_len) == -1 && errno != EINPROGRESS) return -1;
+    struct epoll_event ev = {.events = EPOLLOUT | EPOLLIN, .data.u32 = id};
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, s->socket, &ev);
+    s->estado = CONECTANDO;
+    return 0;
+}
+
+// Pedidos que não têm resposta (EXIT) terminam assim que são enviados
+static void pulaSemResposta(SessaoReplay *s) {
+    while (s->respondidos < s->enviados) {
+        const Registro *r = &registros[s->registros[s->respondidos]];
+        if (r->tipo == REGISTRO_PEDIDO && r->quadros > 0) break;
+        if (r->tipo == REGISTRO_PEDIDO) iguais++;
+        s->respondidos++;
+    }
+}
+
+// Envia os registros liberados até a profundidade
+static int enviaPendentes(uint32_t id) {
+    static uint8_t lote[LOTE_ENVIO];
+    SessaoReplay *s = &sessoes[id];
+    if (s->estado != ABERTA) return 0;
+    size_t usado = 0;
+    uint64_t agora = agoraNs();
+    while (s->enviados < s->liberados && s->enviados - s->respondidos < (size_t)profundidade) {
+        size_t indice = s->registros[s->enviados];
+        const Registro *r = &registros[indice];
+        // O servidor fecha a conexão no EXIT sem enviar o que ainda estiver no anel de saída,
+        // então o EXIT, como o FECHA, espera as respostas anteriores
+        bool barreira = r->tipo == REGISTRO_FECHA || r->opcode == ACTION_EXIT;
+        if (barreira && s->respondidos < s->enviados) break;
+        if (r->tipo == REGISTRO_FECHA) {
+            if (usado && send(s->socket, lote, usado, MSG_NOSIGNAL) != (ssize_t)usado) return -1;
+            usado = 0;
+            shutdown(s->socket, SHUT_WR);
+            s->estado = FECHANDO;
+            s->enviados = s->respondidos = s->enviados + 1;
+            break;
+        }
+        if (usado + CABECALHO_TAMANHO + r->tamanho > sizeof(lote)) break;
+
+        uint8_t *quadro = lote + usado;
+        escreveCabecalho(quadro, r->opcode, r->tamanho);
+        memcpy(quadro + CABECALHO_TAMANHO, r->carga, r->tamanho);
+        if (r->opcode == ACTION_RESUME && r->tamanho >= 8) {
+            Token *t = buscaToken(leU64(r->carga));
+            if (t) {
+                // A partida só é guardada quando a dona anterior do token fecha
+                if (t->dona != id && sessoes[t->dona].estado != FECHADA) {
+                    if (!s->esperando_token) num_esperando++;
+                    s->esperando_token = true;
+                    break;
+                }
+                if (t->novo) escreveU64(quadro + CABECALHO_TAMANHO, t->novo);
+                t->dona = id;
+            }
+        }
+        usado += CABECALHO_TAMANHO + r->tamanho;
+        enviado_em[indice] = agora;
+        s->enviados++;
+        pulaSemResposta(s);
+    }
+    if (usado == 0) return 0;
+    ssize_t n = send(s->socket, lote, usado, MSG_NOSIGNAL);
+    return n == (ssize_t)usado ? 0 : -1;
+}
+
+static void terminaResposta(uint32_t id) {
+    SessaoReplay *s = &sessoes[id];
+    size_t indice = s->registros[s->respondidos];
+    const Registro *r = &registros[indice];
+    uint64_t ns = agoraNs() - enviado_em[indice];
+    Histograma *h = &histogramas[r->opcode & 15];
+    h->contagem[faixaHistograma(ns)]++;
+    h->total++;
+    if (ns > h->maximo) h->maximo = ns;
+
+    if (s->soma == r->soma) {
+        iguais++;
+    } else {
+        divergencias++;
+        if (detalhado || divergencias <= DIVERGENCIAS_MOSTRADAS) {
+            printf("divergência: sessão %u, pedido %zu (%s, %u bytes): esperados %u quadros (soma %016llx), "
+                   "recebidos %u (soma %016llx)\n", id, s->respondidos + 1, nomes_opcodes[r->opcode & 15], r->tamanho,
+                   r->quadros, (unsigned long long)r->soma, s->quadros, (unsigned long long)s->soma);
+        }
+    }
+    if (r->token && s->token) {
+        Token *t = buscaToken(r->token);
+        if (t) {
+            t->novo = s->token;
+            t->dona = id;
+        }
+    }
+    s->respondidos++;
+    s->quadros = 0;
+    s->soma = SOMA_INICIAL;
+    s->token = 0;
+    pulaSemResposta(s);
+}
+
+// Separa os quadros recebidos entre as respostas dos pedidos em andamento, na ordem
+static int trataRespostas(uint32_t id) {
+    SessaoReplay *s = &sessoes[id];
+    while (1) {
+        if (s->recebidos == s->capacidade_resposta) {
+            size_t capacidade = s->capacidade_resposta ? s->capacidade_resposta * 2 : 65536;
+            uint8_t *resposta = realloc(s->resposta, capacidade);
+            if (!resposta) return -1;
+            s->resposta = resposta;
+            s->capacidade_resposta = capacidade;
+        }
+        ssize_t n = recv(s->socket, s->resposta + s->recebidos, s->capacidade_resposta - s->recebidos, 0);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return -1;
+        if (n == 0) {
+            // Fim normal depois do FECHA ou do EXIT; antes disso, respostas se perderam
+            if (s->respondidos < s->enviados) return -1;
+            fechaSessao(id);
+            return 0;
+        }
+        s->recebidos += n;
+        ultima_resposta = agoraNs();
+
+        size_t inicio = 0;
+        while (s->recebidos - inicio >= CABECALHO_TAMANHO) {
+            const uint8_t *quadro = s->resposta + inicio;
+            uint32_t tamanho = leU32(quadro + 2);
+            if (s->recebidos - inicio < CABECALHO_TAMANHO + tamanho) {
+                // Quadro maior que o buffer: cresce no próximo recv
+                if (CABECALHO_TAMANHO + tamanho > s->capacidade_resposta) {
+                    uint8_t *resposta = realloc(s->resposta, CABECALHO_TAMANHO + tamanho);
+                    if (!resposta) return -1;
+                    s->resposta = resposta;
+                    s->capacidade_resposta = CABECALHO_TAMANHO + tamanho;
+                }
+                break;
+            }
+            inicio += CABECALHO_TAMANHO + tamanho;
+            uint8_t opcode = quadro[1];
+            if (opcode == ACTION_ROOM_DELTA) continue; // Chega sem pedido
+
+            if (s->respondidos >= s->enviados) {
+                divergencias++;
+                if (detalhado || divergencias <= DIVERGENCIAS_MOSTRADAS) {
+                    printf("divergência: sessão %u, quadro %s sem pedido\n", id, nomes_opcodes[opcode & 15]);
+                }
+                continue;
+            }
+            s->soma = somaBytes(s->soma, &opcode, 1);
+            s->soma = somaBytes(s->soma, quadro + CABECALHO_TAMANHO, cargaComparada(opcode, tamanho));
+            if (opcode == ACTION_TOKEN && tamanho == 8) s->token = leU64(quadro + CABECALHO_TAMANHO);
+            if (++s->quadros == registros[s->registros[s->respondidos]].quadros) terminaResposta(id);
+        }
+        memmove(s->resposta, s->resposta + inicio, s->recebidos - inicio);
+        s->recebidos -= inicio;
+    }
+    return enviaPendentes(id);
+}
+
+static int resolveEndereco(const char *host, const char *porta, struct sockaddr_storage *addr, socklen_t *len) {
+    struct addrinfo hints = {0}, *res;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, porta, &hints, &res) != 0) return -1;
+    memcpy(addr, res->ai_addr, res->ai_addrlen);
+    *len = res->ai_addrlen;
+    freeaddrinfo(res);
+    return 0;
+}
+
+static void aumentaLimiteArquivos(void) {
+    struct rlimit limite;
+    if (getrlimit(RLIMIT_NOFILE, &limite) == 0) {
+        limite.rlim_cur = limite.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limite);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 4) {
+        fprintf(stderr, "Uso: %s <gravacao> <endereco> <porta> [-x velocidade] [-p profundidade] [-v]\n"
+                        "  -x 1 (padrão) reproduz no ritmo gravado, -x 0 o mais rápido possível\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    double velocidade = 1;
+    for (int i = 4; i < argc; i++) {
+        if (strcmp(argv[i], "-x") == 0 && i + 1 < argc) velocidade = atof(argv[++i]);
+        else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) profundidade = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-v") == 0) detalhado = 1;
+        else {
+            fprintf(stderr, "Opção inválida: %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (velocidade < 0 || profundidade < 1) {
+        fprintf(stderr, "Parâmetros inválidos\n");
+        return EXIT_FAILURE;
+    }
+
+    uint64_t inicio_parede;
+    if (carregaGravacao(argv[1], &inicio_parede) == -1) return EXIT_FAILURE;
+    if (num_registros == 0) {
+        fprintf(stderr, "%s: gravação vazia\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    if (resolveEndereco(argv[2], argv[3], &addr, &addr_len) == -1) {
+        fprintf(stderr, "Erro ao resolver endereço\n");
+        return EXIT_FAILURE;
+    }
+    aumentaLimiteArquivos();
+
+    // Registros de todas as sessões na ordem dos instantes gravados
+    size_t *ordem = malloc(num_registros * sizeof(size_t));
+    epoll_fd = epoll_create1(0);
+    if (!ordem || epoll_fd == -1) {
+        perror("Erro ao iniciar");
+        return EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < num_registros; i++) ordem[i] = i;
+    qsort(ordem, num_registros, sizeof(size_t), comparaInstantes);
+    for (uint32_t i = 1; i <= num_sessoes; i++) {
+        sessoes[i].soma = SOMA_INICIAL;
+        sessoes[i].socket = -1;
+        if (sessoes[i].num == 0) sessoes[i].estado = FECHADA;
+    }
+    uint64_t primeiro = registros[ordem[0]].instante;
+    uint64_t duracao_gravada = registros[ordem[num_registros - 1]].instante - primeiro;
+    time_t parede = (time_t)(inicio_parede / 1000000000ull);
+    printf("%zu registros de %u sessões, %.2f s gravados a partir de %s", num_registros, num_sessoes,
+           duracao_gravada / 1e9, ctime(&parede));
+
+    struct epoll_event eventos[MAX_EVENTOS];
+    size_t cursor = 0;
+    uint64_t inicio = agoraNs();
+    ultima_resposta = inicio;
+    while (1) {
+        uint64_t agora = agoraNs();
+        // Libera os registros cujo instante chegou
+        while (cursor < num_registros) {
+            const Registro *r = &registros[ordem[cursor]];
+            uint64_t quando = velocidade > 0 ? inicio + (uint64_t)((r->instante - primeiro) / velocidade) : inicio;
+            if (quando > agora) break;
+            SessaoReplay *s = &sessoes[r->sessao];
+            s->liberados++;
+            if (s->estado == ESPERANDO && conecta(r->sessao, &addr, addr_len) == -1) falha(r->sessao, "erro ao conectar");
+            else marcaPronta(r->sessao);
+            cursor++;
+        }
+        while (num_prontas > 0) {
+            uint32_t id = prontas[--num_prontas];
+            sessoes[id].pronta = false;
+            if (enviaPendentes(id) == -1) falha(id, "erro ao enviar");
+        }
+
+        // Sessões gravadas sem FECHA (ainda abertas no fim da gravação) fecham quando terminam
+        bool ativas = false;
+        for (uint32_t i = 1; i <= num_sessoes; i++) {
+            SessaoReplay *s = &sessoes[i];
+            if (cursor == num_registros && s->estado == ABERTA && s->enviados == s->num && s->respondidos == s->num) {
+                fechaSessao(i);
+            }
+            ativas |= s->estado != FECHADA;
+        }
+        if (cursor == num_registros && !ativas) break;
+        if (agora - ultima_resposta > INATIVIDADE_MAXIMA_NS && cursor == num_registros) {
+            for (uint32_t i = 1; i <= num_sessoes; i++) {
+                if (sessoes[i].estado != FECHADA) falha(i, "sem resposta do servidor");
+            }
+            break;
+        }
+
+        int espera = 100;
+        if (cursor < num_registros && velocidade > 0) {
+            uint64_t quando = inicio + (uint64_t)((registros[ordem[cursor]].instante - primeiro) / velocidade);
+            uint64_t falta = quando > agora ? quando - agora : 0;
+            espera = falta / 1000000 < 100 ? (int)(falta / 1000000) : 100;
+        } else if (cursor < num_registros) {
+            espera = 0;
+        }
+        int n = epoll_wait(epoll_fd, eventos, MAX_EVENTOS, espera);
+        if (n == -1 && errno != EINTR) {
+            perror("Erro no epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            uint32_t id = eventos[i].data.u32;
+            SessaoReplay *s = &sessoes[id];
+            if (s->estado == FECHADA) continue;
+            if (s->estado == CONECTANDO) {
+                int erro = 0;
+                socklen_t len = sizeof(erro);
+                getsockopt(s->socket, SOL_SOCKET, SO_ERROR, &erro, &len);
+                if (erro != 0) {
+                    falha(id, "conexão recusada");
+                    continue;
+                }
+                s->estado = ABERTA;
+                struct epoll_event ev = {.events = EPOLLIN, .data.u32 = id};
+                epoll_ctl(epoll_fd, EPOLL_CTL_MOD, s->socket, &ev);
+                if (enviaPendentes(id) == -1) falha(id, "erro ao enviar");
+            } else if (trataRespostas(id) == -1) {
+                falha(id, "conexão encerrada antes das respostas");
+            }
+        }
+    }
+
+    double segundos = (agoraNs() - inicio) / 1e9;
+    uint64_t total = iguais + divergencias;
+    char ritmo[32];
+    if (velocidade > 0) snprintf(ritmo, sizeof(ritmo), "x%g", velocidade);
+    else snprintf(ritmo, sizeof(ritmo), "máxima");
+    printf("%llu pedidos em %.2f s (%.0f/s, velocidade %s): %llu iguais, %llu divergências, %llu sessões com erro\n",
+           (unsigned long long)total, segundos, total / segundos, ritmo, (unsigned long long)iguais,
+           (unsigned long long)divergencias, (unsigned long long)erros);
+    printf("%-10s %10s %10s %10s %10s\n", "acao", "pedidos", "p50_us", "p99_us", "max_us");
+    for (int op = 0; op < 16; op++) {
+        const Histograma *h = &histogramas[op];
+        if (h->total == 0) continue;
+        printf("%-10s %10llu %10.1f %10.1f %10.1f\n", nomes_opcodes[op], (unsigned long long)h->total,
+               percentil(h, 0.50) / 1e3, percentil(h, 0.99) / 1e3, h->maximo / 1e3);
+    }
+    return divergencias == 0 && erros == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
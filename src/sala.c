@@ -0,0 +1,520 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#include "sala.h"
+#include "sessao.h"
+#include "protocolo.h"
+#include "metricas.h"
+#include "gerador.h"
+#include "recarga.h"
+
+#define BALDES_SALAS 1024
+#define SALA_MAX_JOGADORES 4096 // Ids de jogador são u16, abaixo de SALA_SEM_ID
+#define JOGADORES_INICIAIS 16
+#define JOGADORES_POR_ESCRITA 64 // Jogadores do estado inteiro copiados por anelEscreve
+
+typedef struct {
+    uint16_t linha, coluna;
+    bool ativo;
+    bool alterado; // Já está na lista de alterados do próximo bloco
+} JogadorSala;
+
+struct Sala {
+    uint32_t id;
+    _Atomic int referencias; // Inscritos e listas de sujas; só chega a 0 sob trava_salas
+    int lado;                // 0 para o labirinto do arquivo
+    uint64_t semente;
+    const Labirinto *labirinto;
+    struct Sala *proxima;    // Balde da tabela
+
+    pthread_mutex_t trava;   // Protege o que vem abaixo
+    JogadorSala *jogadores;
+    uint16_t *alterados;     // Ids mudados desde o último bloco
+    size_t capacidade, num_alterados, num_ativos;
+    int grupos[MAX_WORKERS]; // Inscritos por worker (0 ou 1 grupo cada)
+    bool suja[MAX_WORKERS];  // Já está na lista de sujas do worker
+    Bloco *ultimo;           // Último bloco publicado; a sala guarda uma referência
+};
+
+// Inscritos de uma sala em um worker; só o worker dono lê e altera
+typedef struct GrupoSala {
+    Sala *sala;
+    Bloco *visto; // Último bloco já distribuído aos inscritos
+    Sessao *inscritos;
+    size_t num_inscritos;
+    struct GrupoSala *proximo;
+} GrupoSala;
+
+_Thread_local SalasWorker *salas_thread;
+
+static pthread_mutex_t trava_salas = PTHREAD_MUTEX_INITIALIZER;
+static Sala *tabela[BALDES_SALAS];
+
+// Preenchidos antes das threads dos workers começarem; depois só são lidos
+static SalasWorker *todos_workers[MAX_WORKERS];
+static int num_workers;
+
+static Bloco *novoBloco(uint32_t tamanho) {
+    Bloco *bloco = malloc(sizeof(Bloco) + tamanho);
+    if (!bloco) return NULL;
+    atomic_init(&bloco->referencias, 1);
+    atomic_init(&bloco->proximo, NULL);
+    bloco->tamanho = tamanho;
+    return bloco;
+}
+
+// Liberar um bloco solta a referência que ele tinha do seguinte
+void soltaBloco(Bloco *bloco) {
+    while (bloco && atomic_fetch_sub_explicit(&bloco->referencias, 1, memory_order_acq_rel) == 1) {
+        Bloco *seguinte = atomic_load_explicit(&bloco->proximo, memory_order_acquire);
+        free(bloco);
+        bloco = seguinte;
+    }
+}
+
+static Bloco *blocoFila(const FilaBlocos *fila, size_t i) {
+    return fila->itens[(fila->inicio + i) % FILA_BLOCOS];
+}
+
+static bool enfileiraBloco(FilaBlocos *fila, Bloco *bloco) {
+    if (fila->tamanho == FILA_BLOCOS) return false;
+    fila->itens[(fila->inicio + fila->tamanho) % FILA_BLOCOS] = bloco;
+    fila->tamanho++;
+    fila->bytes += bloco->tamanho;
+    return true;
+}
+
+static void retiraBloco(FilaBlocos *fila) {
+    soltaBloco(blocoFila(fila, 0));
+    fila->inicio = (fila->inicio + 1) % FILA_BLOCOS;
+    fila->tamanho--;
+    fila->enviado = 0;
+}
+
+void liberaFilaBlocos(FilaBlocos *fila) {
+    while (fila->tamanho > 0) retiraBloco(fila);
+    fila->bytes = 0;
+}
+
+int trechosSaida(const Anel *anel, const FilaBlocos *fila, size_t max_blocos, struct iovec iov[TRECHOS_SAIDA]) {
+    int n = 0;
+    size_t b = 0;
+    if (max_blocos > fila->tamanho) max_blocos = fila->tamanho;
+    // Um bloco começado vai antes de tudo, mesmo que o anel tenha recebido respostas depois
+    if (fila->enviado > 0) {
+        Bloco *bloco = blocoFila(fila, 0);
+        iov[n++] = (struct iovec){bloco->dados + fila->enviado, bloco->tamanho - fila->enviado};
+        b = 1;
+    }
+    n += anelOcupados(anel, iov + n);
+    for (; b < max_blocos; b++) {
+        Bloco *bloco = blocoFila(fila, b);
+        iov[n++] = (struct iovec){bloco->dados, bloco->tamanho};
+    }
+    return n;
+}
+
+// Consome até o fim do primeiro bloco; retorna os bytes que sobraram
+static size_t consomeBloco(FilaBlocos *fila, size_t n, size_t *terminados) {
+    size_t resto = blocoFila(fila, 0)->tamanho - fila->enviado;
+    if (n < resto) {
+        fila->enviado += n;
+        fila->bytes -= n;
+        return 0;
+    }
+    fila->bytes -= resto;
+    retiraBloco(fila);
+    (*terminados)++;
+    return n - resto;
+}
+
+size_t consomeSaida(Anel *anel, FilaBlocos *fila, size_t n) {
+    size_t terminados = 0;
+    if (n > 0 && fila->enviado > 0) n = consomeBloco(fila, n, &terminados);
+    size_t do_anel = n < anel->tamanho ? n : anel->tamanho;
+    if (do_anel > 0) anelConsome(anel, do_anel);
+    n -= do_anel;
+    while (n > 0 && fila->tamanho > 0) n = consomeBloco(fila, n, &terminados);
+    return terminados;
+}
+
+int iniciaSalasWorker(SalasWorker *salas, int id) {
+    // Sem EFD_NONBLOCK: o epoll só lê quando há aviso, e o io_uring espera a leitura sozinho
+    salas->aviso = eventfd(0, EFD_CLOEXEC);
+    if (salas->aviso == -1) return -1;
+    salas->id = id;
+    atomic_init(&salas->avisado, false);
+    salas->grupos = NULL;
+    salas->sujas = NULL;
+    salas->num_sujas = salas->capacidade_sujas = 0;
+    todos_workers[id] = salas;
+    if (id >= num_workers) num_workers = id + 1;
+    return 0;
+}
+
+// As duas pontas trocam o indicador com ordem acq_rel: ou quem publica vê o aviso já limpo e
+// escreve no eventfd, ou quem recebe vê o bloco publicado antes da troca
+void recebeAviso(SalasWorker *salas) {
+    atomic_exchange_explicit(&salas->avisado, false, memory_order_acq_rel);
+}
+
+static void avisa(SalasWorker *salas) {
+    if (atomic_exchange_explicit(&salas->avisado, true, memory_order_acq_rel)) return;
+    uint64_t um = 1;
+    if (write(salas->aviso, &um, sizeof(um)) == -1) registraLog("Erro ao avisar o worker %d\n", salas->id);
+}
+
+static Sala *procuraSala(uint32_t id) {
+    for (Sala *sala = tabela[id % BALDES_SALAS]; sala; sala = sala->proxima) {
+        if (sala->id == id) return sala;
+    }
+    return NULL;
+}
+
+static void destroiSala(Sala *sala) {
+    soltaBloco(sala->ultimo);
+    if (sala->lado) devolveLabirintoGerado(sala->labirinto);
+    else devolveLabirinto(sala->labirinto);
+    pthread_mutex_destroy(&sala->trava);
+    free(sala->jogadores);
+    free(sala->alterados);
+    free(sala);
+}
+
+static Sala *criaSala(uint32_t id, int lado, uint64_t semente, const Labirinto *padrao) {
+    Sala *sala = calloc(1, sizeof(Sala));
+    if (!sala) return NULL;
+    sala->id = id;
+    atomic_init(&sala->referencias, 1);
+    sala->labirinto = padrao;
+    if (!lado) retemLabirinto(padrao); // A sala segura a versão do arquivo mesmo sem sessões nela
+    if (lado) {
+        sala->lado = ladoGerado(lado);
+        sala->semente = semente;
+        sala->labirinto = obtemLabirintoGerado(sala->lado, semente);
+    }
+    // Bloco vazio inicial: os grupos sempre têm um bloco de onde seguir a corrente
+    sala->ultimo = novoBloco(0);
+    if (!sala->labirinto || !sala->ultimo) {
+        if (sala->lado && sala->labirinto) devolveLabirintoGerado(sala->labirinto);
+        if (!sala->lado) devolveLabirinto(sala->labirinto);
+        free(sala->ultimo);
+        free(sala);
+        return NULL;
+    }
+    pthread_mutex_init(&sala->trava, NULL);
+    return sala;
+}
+
+Sala *abreSala(uint32_t id, int lado, uint64_t semente, const Labirinto *padrao) {
+    pthread_mutex_lock(&trava_salas);
+    Sala *sala = procuraSala(id);
+    if (sala) atomic_fetch_add(&sala->referencias, 1);
+    pthread_mutex_unlock(&trava_salas);
+    if (sala) return sala;
+
+    // Como no cache de labirintos, a sala nova (e seu labirinto) é montada fora da trava
+    Sala *nova = criaSala(id, lado, semente, padrao);
+    if (!nova) return NULL;
+    pthread_mutex_lock(&trava_salas);
+    sala = procuraSala(id);
+    if (sala) {
+        atomic_fetch_add(&sala->referencias, 1);
+    } else {
+        nova->proxima = tabela[id % BALDES_SALAS];
+        tabela[id % BALDES_SALAS] = nova;
+    }
+    pthread_mutex_unlock(&trava_salas);
+    if (sala) {
+        destroiSala(nova);
+        return sala;
+    }
+    return nova;
+}
+
+static void soltaSala(Sala *sala) {
+    pthread_mutex_lock(&trava_salas);
+    bool ultima = atomic_fetch_sub(&sala->referencias, 1) == 1;
+    if (ultima) {
+        Sala **p = &tabela[sala->id % BALDES_SALAS];
+        while (*p != sala) p = &(*p)->proxima;
+        *p = sala->proxima;
+    }
+    pthread_mutex_unlock(&trava_salas);
+    if (ultima) destroiSala(sala);
+}
+
+bool salaAberta(uint32_t id) {
+    pthread_mutex_lock(&trava_salas);
+    bool aberta = procuraSala(id) != NULL;
+    pthread_mutex_unlock(&trava_salas);
+    return aberta;
+}
+
+const Labirinto *labirintoSala(const Sala *sala, int *lado, uint64_t *semente) {
+    *lado = sala->lado;
+    *semente = sala->semente;
+    return sala->labirinto;
+}
+
+// Com a trava da sala. O worker passa a publicar a sala no fim da volta
+static void marcaAlterado(Sala *sala, uint16_t id, SalasWorker *w) {
+    JogadorSala *jogador = &sala->jogadores[id];
+    if (!jogador->alterado) {
+        jogador->alterado = true;
+        sala->alterados[sala->num_alterados++] = id;
+    }
+    if (sala->suja[w->id]) return;
+    if (w->num_sujas == w->capacidade_sujas) {
+        size_t capacidade = w->capacidade_sujas ? w->capacidade_sujas * 2 : 16;
+        Sala **sujas = realloc(w->sujas, capacidade * sizeof(Sala *));
+        if (!sujas) return; // Sai no bloco de outra mudança
+        w->sujas = sujas;
+        w->capacidade_sujas = capacidade;
+    }
+    // Quem chama é inscrito, então a sala tem referências e pode ganhar mais uma sem a trava global
+    atomic_fetch_add(&sala->referencias, 1);
+    sala->suja[w->id] = true;
+    w->sujas[w->num_sujas++] = sala;
+}
+
+// Com a trava da sala. Retorna SALA_SEM_ID se a sala está cheia
+static uint16_t novoJogador(Sala *sala) {
+    for (size_t i = 0; i < sala->capacidade; i++) {
+        if (!sala->jogadores[i].ativo) return (uint16_t)i;
+    }
+    if (sala->capacidade == SALA_MAX_JOGADORES) return SALA_SEM_ID;
+    size_t capacidade = sala->capacidade ? sala->capacidade * 2 : JOGADORES_INICIAIS;
+    JogadorSala *jogadores = realloc(sala->jogadores, capacidade * sizeof(JogadorSala));
+    if (!jogadores) return SALA_SEM_ID;
+    sala->jogadores = jogadores;
+    uint16_t *alterados = realloc(sala->alterados, capacidade * sizeof(uint16_t));
+    if (!alterados) return SALA_SEM_ID;
+    sala->alterados = alterados;
+    memset(jogadores + sala->capacidade, 0, (capacidade - sala->capacidade) * sizeof(JogadorSala));
+    uint16_t id = (uint16_t)sala->capacidade;
+    sala->capacidade = capacidade;
+    return id;
+}
+
+// Com a trava da sala: ACTION_ROOM com todos os jogadores ativos, copiado em partes para o anel
+static void escreveEstado(Sessao *sessao, Sala *sala) {
+    const Labirinto *lab = sala->labirinto;
+    uint8_t buffer[CABECALHO_TAMANHO + SALA_CABECALHO + JOGADORES_POR_ESCRITA * SALA_JOGADOR_TAMANHO];
+    escreveCabecalho(buffer, ACTION_ROOM, SALA_CABECALHO + sala->num_ativos * SALA_JOGADOR_TAMANHO);
+    uint8_t *p = buffer + CABECALHO_TAMANHO;
+    escreveU32(p, sala->id);
+    escreveU16(p + 4, lab->linhas);
+    escreveU16(p + 6, lab->colunas);
+    escreveU16(p + 8, sessao->id_sala);
+    escreveU16(p + 10, (uint16_t)sala->num_ativos);
+    p += SALA_CABECALHO;
+
+    int na_parte = 0;
+    for (size_t i = 0; i < sala->capacidade; i++) {
+        const JogadorSala *jogador = &sala->jogadores[i];
+        if (!jogador->ativo) continue;
+        escreveU16(p, (uint16_t)i);
+        escreveU16(p + 2, jogador->linha);
+        escreveU16(p + 4, jogador->coluna);
+        p += SALA_JOGADOR_TAMANHO;
+        if (++na_parte == JOGADORES_POR_ESCRITA) {
+            anelEscreve(&sessao->saida, buffer, p - buffer);
+            p = buffer;
+            na_parte = 0;
+        }
+    }
+    anelEscreve(&sessao->saida, buffer, p - buffer);
+}
+
+// Com a trava da sala
+static GrupoSala *grupoLocal(SalasWorker *w, Sala *sala) {
+    for (GrupoSala *grupo = w->grupos; grupo; grupo = grupo->proximo) {
+        if (grupo->sala == sala) return grupo;
+    }
+    GrupoSala *grupo = calloc(1, sizeof(GrupoSala));
+    if (!grupo) return NULL;
+    grupo->sala = sala;
+    grupo->visto = sala->ultimo;
+    atomic_fetch_add(&grupo->visto->referencias, 1);
+    grupo->proximo = w->grupos;
+    w->grupos = grupo;
+    sala->grupos[w->id]++;
+    return grupo;
+}
+
+// Com a trava da sala; o grupo já está vazio
+static void removeGrupo(SalasWorker *w, GrupoSala *grupo) {
+    GrupoSala **p = &w->grupos;
+    while (*p != grupo) p = &(*p)->proximo;
+    *p = grupo->proximo;
+    grupo->sala->grupos[w->id]--;
+    soltaBloco(grupo->visto);
+    free(grupo);
+}
+
+int inscreveSala(Sessao *sessao, Sala *sala, bool espectador) {
+    SalasWorker *w = salas_thread;
+    pthread_mutex_lock(&sala->trava);
+    GrupoSala *grupo = grupoLocal(w, sala);
+    uint16_t id = grupo && !espectador ? novoJogador(sala) : SALA_SEM_ID;
+    if (!grupo || (!espectador && id == SALA_SEM_ID)) {
+        if (grupo && grupo->num_inscritos == 0) removeGrupo(w, grupo);
+        pthread_mutex_unlock(&sala->trava);
+        soltaSala(sala);
+        return -1;
+    }
+
+    sessao->sala = sala;
+    sessao->grupo = grupo;
+    sessao->id_sala = id;
+    sessao->dessincronizada = false;
+    if (!espectador) {
+        sala->jogadores[id] = (JogadorSala){(uint16_t)sessao->player_pos[0], (uint16_t)sessao->player_pos[1], true, sala->jogadores[id].alterado};
+        sala->num_ativos++;
+        marcaAlterado(sala, id, w);
+    }
+    escreveEstado(sessao, sala);
+    pthread_mutex_unlock(&sala->trava);
+
+    sessao->inscrito_anterior = NULL;
+    sessao->inscrito_proximo = grupo->inscritos;
+    if (grupo->inscritos) grupo->inscritos->inscrito_anterior = sessao;
+    grupo->inscritos = sessao;
+    grupo->num_inscritos++;
+    return 0;
+}
+
+// Blocos que já estão na fila da sessão ainda são enviados
+void saiSala(Sessao *sessao) {
+    Sala *sala = sessao->sala;
+    if (!sala) return;
+    SalasWorker *w = salas_thread;
+    GrupoSala *grupo = sessao->grupo;
+    if (sessao->inscrito_anterior) sessao->inscrito_anterior->inscrito_proximo = sessao->inscrito_proximo;
+    else grupo->inscritos = sessao->inscrito_proximo;
+    if (sessao->inscrito_proximo) sessao->inscrito_proximo->inscrito_anterior = sessao->inscrito_anterior;
+    grupo->num_inscritos--;
+
+    pthread_mutex_lock(&sala->trava);
+    if (sessao->id_sala != SALA_SEM_ID) {
+        sala->jogadores[sessao->id_sala].ativo = false;
+        sala->num_ativos--;
+        marcaAlterado(sala, sessao->id_sala, w);
+    }
+    if (grupo->num_inscritos == 0) removeGrupo(w, grupo);
+    pthread_mutex_unlock(&sala->trava);
+
+    sessao->sala = NULL;
+    sessao->grupo = NULL;
+    sessao->inscrito_anterior = sessao->inscrito_proximo = NULL;
+    sessao->dessincronizada = false;
+    soltaSala(sala);
+}
+
+void moveNaSala(Sessao *sessao) {
+    Sala *sala = sessao->sala;
+    if (!sala || sessao->id_sala == SALA_SEM_ID) return;
+    pthread_mutex_lock(&sala->trava);
+    JogadorSala *jogador = &sala->jogadores[sessao->id_sala];
+    jogador->linha = (uint16_t)sessao->player_pos[0];
+    jogador->coluna = (uint16_t)sessao->player_pos[1];
+    marcaAlterado(sala, sessao->id_sala, salas_thread);
+    pthread_mutex_unlock(&sala->trava);
+}
+
+void ressincronizaSala(Sessao *sessao) {
+    Sala *sala = sessao->sala;
+    if (!sala || !sessao->dessincronizada || pendentesSaida(sessao) > SAIDA_BAIXA) return;
+    sessao->dessincronizada = false;
+    pthread_mutex_lock(&sala->trava);
+    escreveEstado(sessao, sala);
+    pthread_mutex_unlock(&sala->trava);
+    if (metricas_thread) somaContador(&metricas_thread->ressincronizacoes_sala, 1);
+}
+
+// Com a trava da sala: serializa as mudanças pendentes em um bloco e o põe no fim da corrente
+static void publicaBloco(Sala *sala, int proprio) {
+    size_t n = sala->num_alterados;
+    uint32_t carga = (uint32_t)(SALA_DELTA_CABECALHO + n * SALA_JOGADOR_TAMANHO);
+    Bloco *bloco = novoBloco(CABECALHO_TAMANHO + carga);
+    if (!bloco) return; // As mudanças continuam pendentes
+    escreveCabecalho(bloco->dados, ACTION_ROOM_DELTA, carga);
+    uint8_t *p = bloco->dados + CABECALHO_TAMANHO;
+    escreveU32(p, sala->id);
+    escreveU16(p + 4, (uint16_t)n);
+    p += SALA_DELTA_CABECALHO;
+    for (size_t k = 0; k < n; k++, p += SALA_JOGADOR_TAMANHO) {
+        uint16_t id = sala->alterados[k];
+        JogadorSala *jogador = &sala->jogadores[id];
+        jogador->alterado = false;
+        escreveU16(p, id);
+        escreveU16(p + 2, jogador->ativo ? jogador->linha : SALA_SEM_ID);
+        escreveU16(p + 4, jogador->ativo ? jogador->coluna : 0);
+    }
+    sala->num_alterados = 0;
+
+    // Uma referência vem do bloco anterior e outra fica com a sala
+    atomic_store_explicit(&bloco->referencias, 2, memory_order_relaxed);
+    atomic_store_explicit(&sala->ultimo->proximo, bloco, memory_order_release);
+    Bloco *anterior = sala->ultimo;
+    sala->ultimo = bloco;
+    soltaBloco(anterior);
+    if (metricas_thread) somaContador(&metricas_thread->blocos_sala, 1);
+
+    for (int w = 0; w < num_workers; w++) {
+        if (w != proprio && sala->grupos[w] > 0) avisa(todos_workers[w]);
+    }
+}
+
+void publicaSalas(void) {
+    SalasWorker *w = salas_thread;
+    for (size_t i = 0; i < w->num_sujas; i++) {
+        Sala *sala = w->sujas[i];
+        pthread_mutex_lock(&sala->trava);
+        sala->suja[w->id] = false;
+        if (sala->num_alterados > 0) publicaBloco(sala, w->id);
+        pthread_mutex_unlock(&sala->trava);
+        soltaSala(sala);
+    }
+    w->num_sujas = 0;
+}
+
+// Entrega um bloco a todos os inscritos do grupo. Quem está com a saída cheia perde o bloco
+// e, quando drenar, recebe o estado inteiro no lugar dos que perdeu
+static void entregaBloco(GrupoSala *grupo, Bloco *bloco, void (*marca)(void *, Sessao *), void *contexto) {
+    // Uma referência por inscrito somada de uma vez; os que não recebem devolvem a sua
+    atomic_fetch_add_explicit(&bloco->referencias, (uint32_t)grupo->num_inscritos, memory_order_relaxed);
+    uint64_t entregues = 0;
+    for (Sessao *s = grupo->inscritos; s; s = s->inscrito_proximo) {
+        if (!s->dessincronizada && pendentesSaida(s) < SAIDA_ALTA && enfileiraBloco(&s->blocos, bloco)) {
+            entregues++;
+        } else {
+            s->dessincronizada = true;
+            atomic_fetch_sub_explicit(&bloco->referencias, 1, memory_order_relaxed); // O grupo ainda alcança o bloco
+        }
+        marca(contexto, s);
+    }
+    if (metricas_thread) somaContador(&metricas_thread->entregas_sala, entregues);
+}
+
+void distribuiSalas(void (*marca)(void *contexto, Sessao *sessao), void *contexto) {
+    for (GrupoSala *grupo = salas_thread->grupos; grupo; grupo = grupo->proximo) {
+        Bloco *ultimo = grupo->visto;
+        Bloco *bloco = atomic_load_explicit(&ultimo->proximo, memory_order_acquire);
+        if (!bloco) continue;
+        // Os blocos depois de `visto` estão vivos: cada um é referenciado pelo anterior
+        for (; bloco; bloco = atomic_load_explicit(&bloco->proximo, memory_order_acquire)) {
+            entregaBloco(grupo, bloco, marca, contexto);
+            ultimo = bloco;
+        }
+        atomic_fetch_add_explicit(&ultimo->referencias, 1, memory_order_relaxed);
+        soltaBloco(grupo->visto);
+        grupo->visto = ultimo;
+    }
+}
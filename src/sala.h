@@ -0,0 +1,93 @@
+#ifndef SALA_H
+#define SALA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <sys/uio.h>
+
+#include "anel.h"
+#include "labirinto.h"
+
+// Salas: vários jogadores no mesmo labirinto vendo as posições uns dos outros, e espectadores
+// que só recebem. As mudanças de uma sala em uma volta do laço de eventos viram um único bloco
+// (quadro ACTION_ROOM_DELTA já serializado) com contagem de referências, que entra na fila de
+// saída de cada inscrito sem ser copiado.
+//
+// Cada worker mantém, para cada sala com inscritos seus, um grupo com a lista desses inscritos
+// e o último bloco que distribuiu. Quem publica acorda (eventfd) os outros workers com
+// inscritos na sala; cada um distribui os blocos novos aos seus. Nenhuma sessão é tocada por
+// outra thread.
+
+typedef struct Sessao Sessao;
+typedef struct Sala Sala;
+
+// Imutável depois de publicado. Cada bloco tem uma referência para o seguinte da sala, então
+// quem guarda um bloco alcança todos os posteriores
+typedef struct Bloco {
+    _Atomic uint32_t referencias;
+    uint32_t tamanho;
+    struct Bloco *_Atomic proximo;
+    uint8_t dados[];
+} Bloco;
+
+void soltaBloco(Bloco *bloco);
+
+// Blocos de sala esperando envio em uma sessão, depois das respostas do anel de saída
+#define FILA_BLOCOS 64
+#define TRECHOS_SAIDA (FILA_BLOCOS + 2) // iovecs de trechosSaida no pior caso
+
+typedef struct {
+    Bloco *itens[FILA_BLOCOS];
+    uint16_t inicio, tamanho;
+    uint32_t enviado; // Bytes do primeiro bloco já enviados
+    size_t bytes;     // Bytes ainda não enviados
+} FilaBlocos;
+
+// Trechos a enviar na ordem do fluxo: o resto de um bloco já começado, as respostas do anel
+// e os blocos seguintes, até `max_blocos` blocos. Nenhum quadro é intercalado com outro
+int trechosSaida(const Anel *anel, const FilaBlocos *fila, size_t max_blocos, struct iovec iov[TRECHOS_SAIDA]);
+// Consome `n` bytes enviados na mesma ordem. Retorna quantos blocos terminaram
+size_t consomeSaida(Anel *anel, FilaBlocos *fila, size_t n);
+void liberaFilaBlocos(FilaBlocos *fila);
+
+// Estado de salas de um worker
+typedef struct {
+    int id;
+    int aviso;            // eventfd escrito por quem publica em sala com inscritos deste worker
+    _Atomic bool avisado; // Já há um aviso pendente; evita um write por publicação
+    struct GrupoSala *grupos;
+    Sala **sujas;         // Salas com mudanças feitas por este worker, publicadas no fim da volta
+    size_t num_sujas, capacidade_sujas;
+} SalasWorker;
+
+extern _Thread_local SalasWorker *salas_thread;
+
+// Cria o eventfd e registra o worker; antes das threads começarem
+int iniciaSalasWorker(SalasWorker *salas, int id);
+// Limpa o aviso; chamado quando o eventfd é lido
+void recebeAviso(SalasWorker *salas);
+
+// Referência para a sala `id`, criada se preciso com o labirinto de lado e semente (ou com
+// `padrao` se lado é 0). O labirinto gerado precisa estar pronto no cache. NULL sem memória
+Sala *abreSala(uint32_t id, int lado, uint64_t semente, const Labirinto *padrao);
+// Se a sala existe; quem entra nela não precisa do labirinto que pediu
+bool salaAberta(uint32_t id);
+// Labirinto da sala e, se gerado, lado e semente (lado 0 para o labirinto do arquivo)
+const Labirinto *labirintoSala(const Sala *sala, int *lado, uint64_t *semente);
+// Inscreve a sessão na posição atual, ficando com a referência de abreSala, e escreve o estado
+// da sala no anel de saída. Retorna -1 (e solta a referência) se a sala está cheia
+int inscreveSala(Sessao *sessao, Sala *sala, bool espectador);
+void saiSala(Sessao *sessao);
+// Registra a posição atual do jogador para o próximo bloco da sala
+void moveNaSala(Sessao *sessao);
+// Envia o estado inteiro a quem perdeu blocos, quando a saída já drenou
+void ressincronizaSala(Sessao *sessao);
+
+// Fim da volta do laço: publica um bloco por sala suja e entrega os blocos novos das salas
+// com inscritos neste worker, chamando `marca` para cada sessão que ganhou algo para enviar
+void publicaSalas(void);
+void distribuiSalas(void (*marca)(void *contexto, Sessao *sessao), void *contexto);
+
+#endif
@@ -1,325 +1,296 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
 #include <stdbool.h>
+#include <sys/uio.h>
+
+#include "protocolo.h"
+#include "labirinto.h"
+#include "metricas.h"
+#include "anel.h"
+#include "gerador.h"
+#include "sessao.h"
+#include "uring.h"
+#include "persistencia.h"
+#include "sala.h"
+#include "lote.h"
+#include "gravacao.h"
+#include "recarga.h"
 
 #define PORT 51511 // Porta padrão
-#define MAX_CLIENTS 1 // Número máximo de clientes suportados
+#define MAX_EVENTOS 256 // Eventos tratados por iteração do epoll
 #define BUFFER_SIZE 1024 // Tamanho do buffer para mensagens
-#define TAMANHO_LABIRINTO 10 // Tamanho máximo do labirinto
-
-// Tipos de ações
-#define ACTION_START 0
-#define ACTION_MOVE 1
-#define ACTION_MAP 2
-#define ACTION_HINT 3
-#define ACTION_UPDATE 4
-#define ACTION_WIN 5
-#define ACTION_RESET 6
-#define ACTION_EXIT 7
-
-// Representação do labirinto
-#define WALL 0
-#define PATH 1
-#define ENTRY 2
-#define EXIT 3
-#define UNKNOWN 4
-#define PLAYER 5
-#define PLAYER_ENTRY 6
-
-// Estrutura da mensagem
-struct action {
-    int type;
-    int moves[100];
-    int board[TAMANHO_LABIRINTO][TAMANHO_LABIRINTO];
-};
 
-typedef struct {
-    int x, y;
-    int path[100];
-    int path_length;
-} Node;
-
-void enviaMapaCompleto(int client_socket, int board[TAMANHO_LABIRINTO][TAMANHO_LABIRINTO]) {
-    struct action server_response = {0};
-    server_response.type = ACTION_WIN;
-    // Revelar todo o labirinto
-    for (int i = 0; i < TAMANHO_LABIRINTO; i++) {
-        for (int j = 0; j < TAMANHO_LABIRINTO; j++) {
-            if(board[i][j]==PLAYER_ENTRY){
-                    server_response.board[i][j] = PLAYER;
-            }else{
-                server_response.board[i][j] = board[i][j]; // Revela o conteúdo da célula
-            }
-        }
+void configuraServidor(const char *version, int port, struct sockaddr_storage *server_addr, socklen_t *addr_len) {
+    if (strcmp(version, "v4") == 0) {
+        struct sockaddr_in *addr = (struct sockaddr_in *)server_addr;
+        *addr_len = sizeof(struct sockaddr_in);
+        addr->sin_family = AF_INET;
+        addr->sin_port = htons(port);
+        addr->sin_addr.s_addr = INADDR_ANY;
+    } else if (strcmp(version, "v6") == 0) {
+        struct sockaddr_in6 *addr = (struct sockaddr_in6 *)server_addr;
+        *addr_len = sizeof(struct sockaddr_in6);
+        addr->sin6_family = AF_INET6;
+        addr->sin6_port = htons(port);
+        addr->sin6_addr = in6addr_any;
+    } else {
+        fprintf(stderr, "Versão de IP inválida: %s\n", version);
+        exit(EXIT_FAILURE);
     }
-    // Enviar a resposta com o labirinto completo para o cliente
-    send(client_socket, &server_response, sizeof(server_response), 0);
 }
 
-void enviaMapa(int client_socket, int board[TAMANHO_LABIRINTO][TAMANHO_LABIRINTO], int x, int y) {
-    struct action server_response = {0};
-    server_response.type = ACTION_UPDATE;
-
-    // Percorrer o labirinto e decidir o que enviar
-    for (int i = 0; i < TAMANHO_LABIRINTO; i++) {
-        for (int j = 0; j < TAMANHO_LABIRINTO; j++) {
-            // Revelar células dentro de um raio de 1 célula ao redor da posição do jogador
-            if (abs(i - x) <= 1 && abs(j - y) <= 1) {
-                if(board[i][j]==PLAYER_ENTRY){
-                    server_response.board[i][j] = PLAYER;
-                }else{
-                    server_response.board[i][j] = board[i][j]; // Revela o conteúdo da célula
-                }
-            } else {
-                server_response.board[i][j] = UNKNOWN; // Células fora do alcance permanecem ocultas
-            }
-        }
-    }
-
-    // Enviar a resposta com o labirinto parcial para o cliente
-    send(client_socket, &server_response, sizeof(server_response), 0);
+// A sessão é liberada (e a partida guardada) antes do close: quando o cliente vê o fim da
+// conexão, um RESUME em outra conexão já encontra o retrato
+void encerraSessao(int epoll_fd, Sessao *sessao) {
+    int socket = sessao->socket;
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, socket, NULL);
+    liberaSessao(sessao);
+    close(socket);
 }
 
-void carregaLabirinto(const char *filename, int board[TAMANHO_LABIRINTO][TAMANHO_LABIRINTO]) {
-    FILE *file = fopen(filename, "r");
-    if (!file) {
-        perror("Erro ao abrir o arquivo do labirinto");
-        exit(EXIT_FAILURE);
-    }
-
-    int i = 0, j = 0;
-    int ch;
-    while ((ch = fgetc(file)) != EOF) {
-        if (ch == '\n') {
-            i++;
-            j = 0; // Reiniciar a coluna para a nova linha
-        } else if (ch >= '0' && ch <= '5') {
-            board[i][j] = ch - '0';
-            j++;
+// Lê tudo o que estiver disponível no socket, preenchendo as duas partes livres do anel
+// com um único readv, e trata cada quadro completo. Retorna 0 se a sessão deve ser encerrada
+int trataLeitura(Sessao *sessao) {
+    while (!leituraSuspensa(sessao)) {
+        struct iovec iov[2];
+        int partes = anelLivres(&sessao->entrada, iov);
+        ssize_t bytes_received = readv(sessao->socket, iov, partes);
+        if (bytes_received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 1;
+        if (bytes_received < 0 && errno == EINTR) continue;
+        if (bytes_received <= 0) {
+            registraLog("client desconnected\n");
+            return 0;
         }
-    }
-
-    fclose(file);
-}
+        sessao->entrada.tamanho += bytes_received;
+        if (metricas_thread) somaContador(&metricas_thread->bytes_recebidos, bytes_received);
 
-void movimentosValidos(int board[TAMANHO_LABIRINTO][TAMANHO_LABIRINTO], int player_pos[2], int moves[100]) {
-    int x = player_pos[0], y = player_pos[1];
-    int idx = 0;
-
-    if (x > 0 && board[x - 1][y] != WALL) moves[idx++] = 1; // Cima
-    if (y < TAMANHO_LABIRINTO - 1 && board[x][y + 1] != WALL) moves[idx++] = 2; // Direita
-    if (x < TAMANHO_LABIRINTO - 1 && board[x + 1][y] != WALL) moves[idx++] = 3; // Baixo
-    if (y > 0 && board[x][y - 1] != WALL) moves[idx++] = 4; // Esquerda
-
-    while (idx < 100) moves[idx++] = 0; // Preencher restante com 0
-}
-
-int atualizaPosicaoJogador(int board[TAMANHO_LABIRINTO][TAMANHO_LABIRINTO], int *x, int *y, int direction, int client_socket) {
-    
-    if(board[*x][*y]!=EXIT && board[*x][*y]!=ENTRY && board[*x][*y]!=PLAYER_ENTRY){
-        board[*x][*y] = PATH; // Liberar posição atual
-    }
-    
-    if(board[*x][*y]==PLAYER_ENTRY){
-        board[*x][*y] = ENTRY;
+        if (!processaEntrada(sessao)) return 0;
     }
+    return 1;
+}
 
-    if (direction == 1 && *x > 0) {
-        (*x)--; // Cima
-    } else if (direction == 2 && *y < TAMANHO_LABIRINTO - 1) {
-        (*y)++; // Direita
-    } else if (direction == 3 && *x < TAMANHO_LABIRINTO - 1) {
-        (*x)++; // Baixo
-    } else if (direction == 4 && *y > 0) {
-        (*y)--; // Esquerda
+// Envia as respostas acumuladas e os blocos de sala: um sendmsg cobre as duas partes do anel
+// e os blocos, que vão direto da memória compartilhada. Para quando tudo foi enviado ou o
+// kernel não aceita mais bytes. Retorna 0 se a conexão falhou
+int escreveSaida(Sessao *sessao) {
+    Anel *saida = &sessao->saida;
+    while (saida->tamanho > 0 || sessao->blocos.tamanho > 0) {
+        struct iovec iov[TRECHOS_SAIDA];
+        struct msghdr msg = {0};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = trechosSaida(saida, &sessao->blocos, FILA_BLOCOS, iov);
+        ssize_t enviados = sendmsg(sessao->socket, &msg, MSG_NOSIGNAL);
+        if (enviados < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 1;
+        if (enviados < 0 && errno == EINTR) continue;
+        if (enviados < 0) return 0;
+        consomeSaida(saida, &sessao->blocos, enviados);
+        registraAtividade(sessao);
+        if (metricas_thread) somaContador(&metricas_thread->bytes_enviados, enviados);
     }
+    anelEncolhe(saida, SAIDA_RETIDA);
+    return 1;
+}
 
-    if (board[*x][*y] == EXIT) {
-        enviaMapaCompleto(client_socket, board);
-        return 0;
+// Fim da iteração para uma sessão: envia o que foi acumulado, retoma a leitura quando o
+// cliente consumiu as respostas (ou manda o estado da sala a quem perdeu blocos) e ajusta os
+// eventos do epoll (EPOLLOUT só com envio pendente, EPOLLIN só sem pausa). Retorna 0 se a
+// sessão deve ser encerrada
+int descarregaSessao(int epoll_fd, Sessao *sessao) {
+    while (1) {
+        if (!escreveSaida(sessao)) return 0;
+        if (sessao->dessincronizada && pendentesSaida(sessao) <= SAIDA_BAIXA) {
+            ressincronizaSala(sessao);
+            continue;
+        }
+        if (!sessao->pausada || pendentesSaida(sessao) > SAIDA_BAIXA) break;
+        sessao->pausada = false;
+        if (!processaEntrada(sessao)) return 0;
     }
 
-    if(board[*x][*y]!=ENTRY && board[*x][*y]!=EXIT){
-        board[*x][*y] = PLAYER;
-    }
-    else{
-        board[*x][*y] = PLAYER_ENTRY;
+    uint32_t interesse = (leituraSuspensa(sessao) ? 0 : EPOLLIN | EPOLLRDHUP) | (pendentesSaida(sessao) ? EPOLLOUT : 0);
+    if (interesse != sessao->interesse) {
+        struct epoll_event ev = {0};
+        ev.events = interesse;
+        ev.data.ptr = sessao;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, sessao->socket, &ev) == -1) return 0;
+        sessao->interesse = interesse;
     }
-
     return 1;
 }
 
-bool posicaoValida(int x, int y, int board[TAMANHO_LABIRINTO][TAMANHO_LABIRINTO], bool visited[TAMANHO_LABIRINTO][TAMANHO_LABIRINTO]) {
-    return x >= 0 && x < TAMANHO_LABIRINTO && y >= 0 && y < TAMANHO_LABIRINTO && board[x][y] != WALL && !visited[x][y];
+int configuraNaoBloqueante(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags == -1) return -1;
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
 }
 
-void buscaCaminho(int board[TAMANHO_LABIRINTO][TAMANHO_LABIRINTO], int start_x, int start_y, int moves[100]) {
-    bool visited[TAMANHO_LABIRINTO][TAMANHO_LABIRINTO] = {false};
-    Node queue[1000];
-    int front = 0, rear = 0;
-
-    Node start = {start_x, start_y, {0}, 0};
-    queue[rear++] = start;
-    visited[start_x][start_y] = true;
-
-    int directions[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
-    int move_codes[4] = {1, 3, 4, 2};
-
-    while (front < rear) {
-        Node current = queue[front++];
-        if (board[current.x][current.y] == EXIT) {
-            memcpy(moves, current.path, sizeof(current.path));
+// Cada worker tem seu socket de escuta (SO_REUSEPORT), seu epoll e suas sessões. Entre
+// threads só são compartilhados os labirintos, somente leitura, e as salas (sala.h)
+typedef struct {
+    int id;
+    int server_socket;
+    int epoll_fd;
+    bool usa_uring; // Transporte io_uring em vez de epoll
+    bool grava;     // Sessões gravadas com -r
+    pthread_t thread;
+    Metricas metricas;
+    RingLog log;
+    RecursosSessao recursos;
+    SalasWorker salas;
+    Gravador gravador;
+    RodaTempo roda; // Ociosidade e limites das sessões
+} Worker;
+
+// Aceita todas as conexões pendentes e registra cada uma no epoll
+void aceitaConexoes(Worker *worker) {
+    while (1) {
+        struct sockaddr_storage client_addr;
+        socklen_t client_addr_len = sizeof(client_addr);
+        int client_socket = accept4(worker->server_socket, (struct sockaddr *)&client_addr, &client_addr_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_socket == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            perror("Erro ao aceitar conexão");
             return;
         }
 
-        for (int i = 0; i < 4; i++) {
-            int new_x = current.x + directions[i][0];
-            int new_y = current.y + directions[i][1];
+        int flag = 1;
+        setsockopt(client_socket, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
 
-            if (posicaoValida(new_x, new_y, board, visited)) {
-                visited[new_x][new_y] = true;
-                Node next = {new_x, new_y, {0}, current.path_length + 1};
-                memcpy(next.path, current.path, sizeof(current.path));
-                next.path[current.path_length] = move_codes[i];
-                queue[rear++] = next;
-            }
+        Sessao *sessao = criaSessao(client_socket);
+        if (!sessao) {
+            close(client_socket);
+            continue;
         }
-    }
 
-    moves[0] = 0; // No path found
-}
-
-void configuraServidor(const char *version, int port, struct sockaddr_storage *server_addr, socklen_t *addr_len) {
-    if (strcmp(version, "v4") == 0) {
-        struct sockaddr_in *addr = (struct sockaddr_in *)server_addr;
-        *addr_len = sizeof(struct sockaddr_in);
-        addr->sin_family = AF_INET;
-        addr->sin_port = htons(port);
-        addr->sin_addr.s_addr = INADDR_ANY;
-    } else if (strcmp(version, "v6") == 0) {
-        struct sockaddr_in6 *addr = (struct sockaddr_in6 *)server_addr;
-        *addr_len = sizeof(struct sockaddr_in6);
-        addr->sin6_family = AF_INET6;
-        addr->sin6_port = htons(port);
-        addr->sin6_addr = in6addr_any;
-    } else {
-        fprintf(stderr, "Versão de IP inválida: %s\n", version);
-        exit(EXIT_FAILURE);
+        struct epoll_event ev = {0};
+        ev.events = sessao->interesse = EPOLLIN | EPOLLRDHUP;
+        ev.data.ptr = sessao;
+        if (epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, client_socket, &ev) == -1) {
+            perror("Erro ao registrar conexão");
+            encerraSessao(worker->epoll_fd, sessao);
+            continue;
+        }
+        registraLog("client connected\n");
     }
 }
 
-void retornaPosicaoJogador(int labyrinth[TAMANHO_LABIRINTO][TAMANHO_LABIRINTO], int pos[2]) {
-    // Percorrer o labirinto e decidir o que enviar
-    for (int i = 0; i < TAMANHO_LABIRINTO; i++) {
-        for (int j = 0; j < TAMANHO_LABIRINTO; j++) {
-            if (labyrinth[i][j] == ENTRY) {
-                pos[0] = i;
-                pos[1] = j;
-                return;
-            }
-        }
-    }
+// Põe a sessão na lista das que serão descarregadas no fim da volta
+static void marcaSessao(void *contexto, Sessao *sessao) {
+    Sessao **marcadas = contexto;
+    if (sessao->marcada) return;
+    sessao->marcada = true;
+    sessao->proxima = *marcadas;
+    *marcadas = sessao;
+}
 
-    // Se não encontrar, retorna (0,0)
-    pos[0] = 0;
-    pos[1] = 0;
+// Temporizador vencido: a sessão é descarregada, ou fechada, no fim da volta
+static void disparaEpoll(void *contexto, Temporizador *t) {
+    Sessao *sessao;
+    int acao = disparaTemporizador(t, &sessao);
+    if (acao == TEMPORIZADOR_ENCERRA) sessao->encerrar = true;
+    if (acao != TEMPORIZADOR_NADA) marcaSessao(contexto, sessao);
 }
 
-void loopCliente(int client_socket, int labyrinth[TAMANHO_LABIRINTO][TAMANHO_LABIRINTO]) {
-    struct action client_action, server_response; 
-    int player_pos[2];
-    retornaPosicaoJogador(labyrinth, player_pos);// Posição inicial do jogador
-    labyrinth[player_pos[0]][player_pos[1]]=PLAYER_ENTRY;
-    // Loop principal de comunicação
+// Laço de eventos: atende todas as sessões do worker sem bloquear em nenhuma delas.
+// Primeiro todos os pedidos prontos são tratados e as respostas acumuladas; depois as salas
+// publicam e distribuem seus blocos, e cada sessão envia o que acumulou com uma chamada só,
+// em vez de uma por resposta
+void loopEpoll(Worker *worker) {
+    struct epoll_event eventos[MAX_EVENTOS];
     while (1) {
-        ssize_t bytes_received = recv(client_socket, &client_action, sizeof(client_action), 0);
-        if (bytes_received <= 0) {
-            printf("client desconnected\n");
-            break;
+        // O epoll_wait acorda a tempo do próximo temporizador. Parado nele o worker não
+        // guarda ponteiros de labirinto sem referência
+        int espera = esperaRoda(&worker->roda, agoraNs());
+        saiVolta();
+        int n = epoll_wait(worker->epoll_fd, eventos, MAX_EVENTOS, espera);
+        entraVolta();
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            // Sem o laço a porta deste worker deixaria de ser atendida: melhor parar tudo
+            perror("Erro no epoll_wait; encerrando o servidor");
+            exit(EXIT_FAILURE);
         }
 
-        memset(&server_response, 0, sizeof(server_response));
-        switch (client_action.type) {
-            case ACTION_START:
-                printf("starting new game\n");
-                server_response.type = ACTION_UPDATE;
-                movimentosValidos(labyrinth, player_pos, server_response.moves);
-                send(client_socket, &server_response, sizeof(server_response), 0);
-                break;
-
-            case ACTION_MOVE:
-                if (client_action.moves[0] >= 1 && client_action.moves[0] <= 4) {
-                    int verifica = atualizaPosicaoJogador(labyrinth, &player_pos[0], &player_pos[1], client_action.moves[0], client_socket);
-                    if(verifica==1){
-                        server_response.type = ACTION_UPDATE;
-                        movimentosValidos(labyrinth, player_pos, server_response.moves);
-                    }
-                }
-                send(client_socket, &server_response, sizeof(server_response), 0);
-                break;
-
-            case ACTION_MAP:
-                server_response.type = ACTION_UPDATE;
-                enviaMapa(client_socket, labyrinth, player_pos[0], player_pos[1]);
-                break;
-
-            case ACTION_HINT:
-                server_response.type = ACTION_UPDATE;
-                buscaCaminho(labyrinth, player_pos[0], player_pos[1], server_response.moves);
-                send(client_socket, &server_response, sizeof(server_response), 0);
-                break;
-
-            case ACTION_RESET:
-                printf("starting new game\n");
-                for (int i = 0; i < TAMANHO_LABIRINTO; i++) {
-                    for (int j = 0; j < TAMANHO_LABIRINTO; j++) {
-                        if (labyrinth[i][j] == ENTRY) {
-                            player_pos[0] = i;
-                            player_pos[1] = j;
-                        }
-                        else if (labyrinth[i][j] == PLAYER){
-                            labyrinth[i][j] = PATH;
-                        }
-                    }
-                }
-                server_response.type = ACTION_UPDATE;
-                movimentosValidos(labyrinth, player_pos, server_response.moves);
-                send(client_socket, &server_response, sizeof(server_response), 0);
-                break;
-
-            case ACTION_EXIT:
-                printf("client disconnected\n");
-                close(client_socket);
-                return;
-
-            default:
-                break;
+        Sessao *marcadas = NULL;
+        avancaRoda(&worker->roda, agoraNs(), disparaEpoll, &marcadas);
+        for (int i = 0; i < n; i++) {
+            Sessao *sessao = eventos[i].data.ptr;
+            if (!sessao) {
+                aceitaConexoes(worker);
+                continue;
+            }
+            if (eventos[i].data.ptr == &worker->salas) {
+                uint64_t avisos;
+                if (read(worker->salas.aviso, &avisos, sizeof(avisos)) == -1 && errno != EINTR) perror("Erro ao ler aviso");
+                recebeAviso(&worker->salas);
+                continue;
+            }
+            if (sessao->encerrar) {
+                // Encerrada por um temporizador nesta volta
+            } else if (eventos[i].events & EPOLLERR) {
+                sessao->encerrar = true;
+            } else if (eventos[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) {
+                sessao->encerrar = !trataLeitura(sessao);
+            }
+            marcaSessao(&marcadas, sessao);
+        }
+        publicaSalas();
+        distribuiSalas(marcaSessao, &marcadas);
+
+        // Cada sessão está no máximo uma vez na lista, então pode ser fechada aqui
+        while (marcadas) {
+            Sessao *sessao = marcadas;
+            marcadas = sessao->proxima;
+            sessao->marcada = false;
+            if (sessao->encerrar || !descarregaSessao(worker->epoll_fd, sessao)) {
+                encerraSessao(worker->epoll_fd, sessao);
+            }
         }
     }
-
-    close(client_socket);
 }
 
-int main(int argc, char *argv[]) {
-    if (argc != 5 || strcmp(argv[3], "-i") != 0) {
-        fprintf(stderr, "Uso: %s <v4/v6> <porta> -i <arquivo_labirinto>\n", argv[0]);
-        return EXIT_FAILURE;
+void *loopEventos(void *arg) {
+    Worker *worker = arg;
+    metricas_thread = &worker->metricas;
+    log_thread = &worker->log;
+    recursos_thread = &worker->recursos;
+    salas_thread = &worker->salas;
+    if (worker->grava) gravador_thread = &worker->gravador;
+    registraEpoca(worker->id);
+    entraVolta();
+    iniciaRoda(&worker->roda, agoraNs());
+    roda_thread = &worker->roda;
+    if (worker->usa_uring) {
+        // O anel é criado na própria thread: com SINGLE_ISSUER só quem o criou pode submeter
+        Uring *uring = criaUring(worker->server_socket);
+        if (uring) {
+            loopUring(uring);
+            return NULL;
+        }
+        registraLog("worker %d: io_uring indisponível, usando epoll\n", worker->id);
     }
+    loopEpoll(worker);
+    return NULL;
+}
 
-    const char *ip_version = argv[1];
-    int port = atoi(argv[2]);
-    char *labyrinth_file = argv[4];
-
-    int labyrinth[TAMANHO_LABIRINTO][TAMANHO_LABIRINTO] = {WALL};
-
-    // Carregar o labirinto do arquivo
-    carregaLabirinto(labyrinth_file, labyrinth);
-
+// Cria um socket de escuta não bloqueante. Com SO_REUSEPORT vários sockets dividem a
+// mesma porta e o kernel distribui as conexões entre eles
+int criaSocketEscuta(const char *ip_version, int port) {
     int server_socket;
-    struct sockaddr_storage server_addr;
+    struct sockaddr_storage server_addr = {0};
     socklen_t addr_len;
 
     // Configurar endereço do servidor
@@ -327,37 +298,208 @@ int main(int argc, char *argv[]) {
 
     // Criar socket
     int domain = (strcmp(ip_version, "v4") == 0) ? AF_INET : AF_INET6;
-    if ((server_socket = socket(domain, SOCK_STREAM, 0)) == -1) {
+    if ((server_socket = socket(domain, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1) {
         perror("Erro ao criar o socket");
-        return EXIT_FAILURE;
+        return -1;
+    }
+
+    int reuse = 1;
+    setsockopt(server_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (setsockopt(server_socket, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) == -1) {
+        perror("Erro ao configurar SO_REUSEPORT");
+        close(server_socket);
+        return -1;
     }
 
     // Vincular o socket
     if (bind(server_socket, (struct sockaddr *)&server_addr, addr_len) == -1) {
         perror("Erro ao vincular o socket");
         close(server_socket);
-        return EXIT_FAILURE;
+        return -1;
     }
 
     // Iniciar escuta
-    if (listen(server_socket, MAX_CLIENTS) == -1) {
+    if (listen(server_socket, SOMAXCONN) == -1 || configuraNaoBloqueante(server_socket) == -1) {
         perror("Erro ao escutar");
         close(server_socket);
+        return -1;
+    }
+    return server_socket;
+}
+
+int iniciaWorker(Worker *worker, int id, const char *ip_version, int port) {
+    worker->id = id;
+    worker->server_socket = criaSocketEscuta(ip_version, port);
+    if (worker->server_socket == -1) return -1;
+
+    worker->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (worker->epoll_fd == -1) {
+        perror("Erro ao criar epoll");
+        return -1;
+    }
+
+    struct epoll_event ev = {0};
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL; // NULL identifica o socket de escuta
+    if (epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, worker->server_socket, &ev) == -1) {
+        perror("Erro ao registrar socket de escuta");
+        return -1;
+    }
+
+    // Avisos de blocos publicados por outros workers em salas com inscritos neste
+    if (iniciaSalasWorker(&worker->salas, id) == -1) {
+        perror("Erro ao criar o eventfd das salas");
+        return -1;
+    }
+    ev.data.ptr = &worker->salas;
+    if (epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, worker->salas.aviso, &ev) == -1) {
+        perror("Erro ao registrar o eventfd das salas");
+        return -1;
+    }
+    return 0;
+}
+
+// Milhares de sessões simultâneas precisam de mais descritores que o limite padrão
+void aumentaLimiteArquivos(void) {
+    struct rlimit limite;
+    if (getrlimit(RLIMIT_NOFILE, &limite) == 0) {
+        limite.rlim_cur = limite.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limite);
+    }
+}
+
+void uso(const char *programa) {
+    fprintf(stderr, "Uso: %s <v4/v6> <porta> -i <arquivo_labirinto> [-t threads] [-s porta_metricas]\n"
+                    "          [-g labirintos_em_cache] [-b epoll|uring] [-w arquivo_wal]\n"
+                    "          [-m tabela|bfs|astar|bidirecional|jps] [-r arquivo_gravacao]\n"
+                    "          [-o segundos_ociosidade] [-l pedidos_por_segundo[:rajada]]\n"
+                    "          [-G lado_maximo[:megabytes]]\n"
+                    "   ou: %s -S <arquivo|diretório|@lista>... [-t threads] [-m motor]\n", programa, programa);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc >= 2 && strcmp(argv[1], "-S") == 0) {
+        return executaLote(argc - 2, argv + 2);
+    }
+    if (argc < 5) {
+        uso(argv[0]);
         return EXIT_FAILURE;
     }
 
-    while (1) {
-        struct sockaddr_storage client_addr;
-        socklen_t client_addr_len = sizeof(client_addr);
-        int client_socket = accept(server_socket, (struct sockaddr *)&client_addr, &client_addr_len);
-        if (client_socket == -1) {
-            perror("Erro ao aceitar conexão");
-            continue;
+    const char *ip_version = argv[1];
+    int port = atoi(argv[2]);
+    char *labyrinth_file = NULL;
+    int num_workers = 1;
+    int stats_port = 0;
+    bool usa_uring = false;
+    const char *wal_file = NULL;
+    const char *gravacao_file = NULL;
+    unsigned ociosidade = 0, taxa = 0, rajada = 0; // Sem -o, sessões paradas ficam abertas
+    unsigned lado_gerado = 1025, megabytes_gerados = 128; // Geração em ~80 ms; ~75 labirintos desse lado
+
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            labyrinth_file = argv[++i];
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            num_workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            stats_port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc && (strcmp(argv[i + 1], "epoll") == 0 || strcmp(argv[i + 1], "uring") == 0)) {
+            usa_uring = strcmp(argv[++i], "uring") == 0;
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            wal_file = argv[++i];
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            gravacao_file = argv[++i];
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            ociosidade = (unsigned)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            // Limite de ACTION_HINT e ACTION_MAP por sessão; a rajada padrão é um segundo de pedidos
+            char *resto;
+            taxa = (unsigned)strtoul(argv[++i], &resto, 10);
+            rajada = *resto == ':' ? (unsigned)strtoul(resto + 1, NULL, 10) : taxa;
+        } else if (strcmp(argv[i], "-G") == 0 && i + 1 < argc) {
+            // Labirintos gerados: maior lado aceito e memória de todo o cache
+            char *resto;
+            lado_gerado = (unsigned)strtoul(argv[++i], &resto, 10);
+            if (*resto == ':') megabytes_gerados = (unsigned)strtoul(resto + 1, NULL, 10);
+        } else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc) {
+            configuraCacheLabirintos(strtoul(argv[++i], NULL, 10));
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc && motorPorNome(argv[i + 1]) != -1) {
+            configuraMotorDica(motorPorNome(argv[++i]));
+        } else {
+            uso(argv[0]);
+            return EXIT_FAILURE;
         }
-        printf("client connected\n");
-        loopCliente(client_socket, labyrinth);
+    }
+    if (!labyrinth_file || num_workers < 1 || num_workers > MAX_WORKERS) {
+        uso(argv[0]);
+        return EXIT_FAILURE;
+    }
+    configuraLimites(ociosidade, taxa, rajada);
+    configuraLimitesGerados((int)(lado_gerado < LADO_MAXIMO ? lado_gerado : LADO_MAXIMO), (size_t)megabytes_gerados << 20);
+
+    // Carregar o labirinto do arquivo (primeira versão; SIGHUP recarrega)
+    if (carregaVersaoInicial(labyrinth_file) == -1) {
+        return EXIT_FAILURE;
+    }
+
+    aumentaLimiteArquivos();
+
+    // Partidas guardadas antes de uma parada voltam para a tabela antes de aceitar conexões
+    if (wal_file && iniciaWal(wal_file) == -1) {
+        perror("Erro ao abrir o WAL");
+        return EXIT_FAILURE;
     }
 
-    close(server_socket);
+    // Todos os sockets são criados antes das threads para que erros apareçam já na partida
+    Worker *workers = calloc(num_workers, sizeof(Worker));
+    if (!workers) {
+        perror("Erro ao alocar os workers");
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; i < num_workers; i++) {
+        if (iniciaWorker(&workers[i], i, ip_version, port) == -1) {
+            return EXIT_FAILURE;
+        }
+        workers[i].usa_uring = usa_uring;
+        workers[i].grava = gravacao_file != NULL;
+        if (gravacao_file) registraGravador(&workers[i].gravador);
+        iniciaRecursosSessao(&workers[i].recursos, &workers[i].metricas);
+        registraWorker(&workers[i].metricas, &workers[i].log);
+    }
+
+    // Mensagens dos workers vão para filas próprias e são escritas por esta thread
+    if (iniciaLogAssincrono() == -1) {
+        fprintf(stderr, "Erro ao criar a thread de log\n");
+        return EXIT_FAILURE;
+    }
+    if (iniciaGeracao() == -1) {
+        fprintf(stderr, "Erro ao criar a thread de geração de labirintos\n");
+        return EXIT_FAILURE;
+    }
+    if (iniciaRecarga() == -1) {
+        perror("Erro ao iniciar a recarga do labirinto");
+        return EXIT_FAILURE;
+    }
+    if (gravacao_file && iniciaGravacao(gravacao_file) == -1) {
+        perror("Erro ao abrir o arquivo de gravação");
+        return EXIT_FAILURE;
+    }
+    if (stats_port > 0 && iniciaServidorMetricas(ip_version, stats_port) == -1) {
+        perror("Erro ao abrir a porta de métricas");
+        return EXIT_FAILURE;
+    }
+
+    for (int i = 1; i < num_workers; i++) {
+        if (pthread_create(&workers[i].thread, NULL, loopEventos, &workers[i]) != 0) {
+            fprintf(stderr, "Erro ao criar a thread do worker %d\n", i);
+            return EXIT_FAILURE;
+        }
+    }
+    loopEventos(&workers[0]); // A thread principal é o worker 0
+
+    for (int i = 1; i < num_workers; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
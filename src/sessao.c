@@ -0,0 +1,677 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sessao.h"
+#include "protocolo.h"
+#include "metricas.h"
+#include "gerador.h"
+#include "persistencia.h"
+#include "gravacao.h"
+#include "recarga.h"
+
+// Acrescenta um quadro às respostas pendentes da sessão; o envio fica para o fim da
+// iteração do laço de eventos, junto com as outras respostas
+static void enviaQuadro(Anel *saida, uint8_t opcode, const uint8_t *carga, size_t tamanho) {
+    uint8_t cabecalho[CABECALHO_TAMANHO];
+    escreveCabecalho(cabecalho, opcode, (uint32_t)tamanho);
+    if (anelEscreve(saida, cabecalho, sizeof(cabecalho)) == -1 || anelEscreve(saida, carga, tamanho) == -1) {
+        registraLog("Memória insuficiente para a resposta\n");
+    }
+}
+
+static void enviaMovimentos(Anel *saida, uint8_t mascara) {
+    enviaQuadro(saida, ACTION_UPDATE, &mascara, 1);
+}
+
+// Resultado de um lote de movimentos
+static void enviaMovido(Anel *saida, uint16_t aplicados, const int player_pos[2], uint8_t mascara, int venceu) {
+    uint8_t carga[MOVIDO_TAMANHO];
+    escreveU16(carga, aplicados);
+    escreveU16(carga + 2, player_pos[0]);
+    escreveU16(carga + 4, player_pos[1]);
+    carga[6] = mascara;
+    carga[7] = (uint8_t)venceu;
+    enviaQuadro(saida, ACTION_MOVED, carga, sizeof(carga));
+}
+
+// Revela o labirinto inteiro quando o jogador chega à saída
+static void enviaMapaCompleto(Anel *saida, const Labirinto *lab) {
+    size_t tamanho = tamanhoTabuleiro(lab->linhas, lab->colunas);
+    uint8_t *carga = arenaAloca(&recursos_thread->arena, tamanho);
+    if (!carga) return;
+    escreveU16(carga, lab->linhas);
+    escreveU16(carga + 2, lab->colunas);
+    // Revelar todo o labirinto: o plano de tipos já está no formato do protocolo
+    memcpy(carga + 4, lab->tipos, tamanho - 4);
+    // Enviar a resposta com o labirinto completo para o cliente
+    enviaQuadro(saida, ACTION_WIN, carga, tamanho);
+}
+
+// Além da janela do jogador, inclui as células já reveladas no modo incremental (se houver),
+// o que permite a um cliente que retomou a partida reconstruir o que já tinha visto
+static void enviaMapa(Anel *saida, const Labirinto *lab, const uint64_t *reveladas, int x, int y) {
+    size_t tamanho = tamanhoTabuleiro(lab->linhas, lab->colunas);
+    uint8_t *carga = arenaAloca(&recursos_thread->arena, tamanho);
+    if (!carga) return;
+    escreveU16(carga, lab->linhas);
+    escreveU16(carga + 2, lab->colunas);
+    // Células fora do alcance permanecem ocultas
+    memset(carga + 4, (UNKNOWN << 4) | UNKNOWN, tamanho - 4);
+    size_t total = (size_t)lab->linhas * lab->colunas;
+    for (size_t w = 0; reveladas && w < (total + 63) / 64; w++) {
+        for (uint64_t bits = reveladas[w]; bits; bits &= bits - 1) {
+            size_t c = w * 64 + __builtin_ctzll(bits);
+            empacotaCelula(carga + 4, c, tipoIndice(lab, c));
+        }
+    }
+
+    // Revelar células dentro de um raio de 1 célula ao redor da posição do jogador
+    for (int i = x - 1; i <= x + 1; i++) {
+        for (int j = y - 1; j <= y + 1; j++) {
+            if (i < 0 || i >= lab->linhas || j < 0 || j >= lab->colunas) continue;
+            int valor = (i == x && j == y) ? PLAYER : tipoCelula(lab, i, j);
+            empacotaCelula(carga + 4, (size_t)i * lab->colunas + j, valor);
+        }
+    }
+
+    // Enviar a resposta com o labirinto parcial para o cliente
+    enviaQuadro(saida, ACTION_MAP, carga, tamanho);
+}
+
+// Envia apenas as células da janela 3x3 que a sessão ainda não tinha visto,
+// marcando-as no conjunto de reveladas
+static void enviaMapaIncremental(Anel *saida, const Labirinto *lab, uint64_t *reveladas, int x, int y) {
+    uint8_t carga[DELTA_CABECALHO + 9 * DELTA_CELULA];
+    escreveU16(carga, lab->linhas);
+    escreveU16(carga + 2, lab->colunas);
+    escreveU16(carga + 4, x);
+    escreveU16(carga + 6, y);
+
+    uint16_t novas = 0;
+    uint8_t *p = carga + DELTA_CABECALHO;
+    for (int i = x - 1; i <= x + 1; i++) {
+        for (int j = y - 1; j <= y + 1; j++) {
+            if (i < 0 || i >= lab->linhas || j < 0 || j >= lab->colunas) continue;
+            size_t c = (size_t)i * lab->colunas + j;
+            if (reveladas[c / 64] & (1ull << (c % 64))) continue;
+            reveladas[c / 64] |= 1ull << (c % 64);
+            escreveU16(p, i);
+            escreveU16(p + 2, j);
+            p[4] = (uint8_t)tipoCelula(lab, i, j);
+            p += DELTA_CELULA;
+            novas++;
+        }
+    }
+    escreveU16(carga + 8, novas);
+
+    enviaQuadro(saida, ACTION_MAP_DELTA, carga, p - carga);
+}
+
+// Envia o caminho com 2 bits por direção
+static void enviaDica(Anel *saida, const Caminho *caminho) {
+    size_t tamanho = 4 + tamanhoDirecoes(caminho->tamanho);
+    uint8_t *carga = arenaAloca(&recursos_thread->arena, tamanho);
+    if (!carga) return;
+    memset(carga, 0, tamanho);
+    escreveU32(carga, (uint32_t)caminho->tamanho);
+    for (size_t i = 0; i < caminho->tamanho; i++) {
+        empacotaDirecao(carga + 4, i, caminho->passos[i]);
+    }
+    enviaQuadro(saida, ACTION_HINT, carga, tamanho);
+}
+
+uint64_t agoraNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+_Thread_local RecursosSessao *recursos_thread;
+
+static int motor_dica = MOTOR_TABELA;
+
+void configuraMotorDica(int motor) {
+    motor_dica = motor;
+}
+
+#define FICHA 1000 // Milésimos de ficha por pedido
+
+static uint64_t ociosidade_tiques; // 0: sessões paradas (e espectadores) não são encerradas
+static uint32_t reposicao_tique; // Milésimos de ficha repostos por tique; 0 sem limite
+static uint32_t capacidade_balde;
+
+void configuraLimites(unsigned ociosidade_s, unsigned taxa, unsigned rajada) {
+    ociosidade_tiques = (uint64_t)ociosidade_s * 1000 / TIQUE_MS;
+    // Em 64 bits e saturado: taxas e rajadas enormes só equivalem a não limitar
+    uint64_t reposicao = (uint64_t)taxa * TIQUE_MS, capacidade = (uint64_t)(rajada > 0 ? rajada : 1) * FICHA;
+    reposicao_tique = reposicao < UINT32_MAX ? (uint32_t)reposicao : UINT32_MAX;
+    capacidade_balde = capacidade < UINT32_MAX ? (uint32_t)capacidade : UINT32_MAX;
+}
+
+#define SESSOES_POR_BLOCO 256
+#define BUFFERS_POR_BLOCO 256
+#define ARENA_INICIAL (256 * 1024)
+
+void iniciaRecursosSessao(RecursosSessao *recursos, Metricas *metricas) {
+    iniciaPool(&recursos->sessoes, sizeof(Sessao), SESSOES_POR_BLOCO, &metricas->pools[POOL_SESSOES]);
+    iniciaPool(&recursos->buffers, ENTRADA_CAPACIDADE, BUFFERS_POR_BLOCO, &metricas->pools[POOL_BUFFERS]);
+    iniciaArena(&recursos->arena, ARENA_INICIAL, &metricas->pools[POOL_ARENA]);
+}
+
+Sessao *criaSessao(int client_socket) {
+    RecursosSessao *recursos = recursos_thread;
+    Sessao *sessao = poolAloca(&recursos->sessoes);
+    if (!sessao) return NULL;
+    const Labirinto *labyrinth = obtemLabirintoAtual();
+    memset(sessao, 0, sizeof(Sessao));
+    sessao->recursos = recursos;
+    sessao->entrada.pool = sessao->saida.pool = sessao->enviando.pool = &recursos->buffers;
+    sessao->socket = client_socket;
+    sessao->labirinto = sessao->padrao = labyrinth;
+    sessao->player_pos[0] = labyrinth->entrada[0]; // Posição inicial do jogador
+    sessao->player_pos[1] = labyrinth->entrada[1];
+    if (anelReserva(&sessao->entrada, ENTRADA_CAPACIDADE) == -1) {
+        devolveLabirinto(labyrinth);
+        poolLibera(&recursos->sessoes, sessao);
+        return NULL;
+    }
+    registraAtividade(sessao);
+    for (int b = 0; b < NUM_BALDES; b++) {
+        sessao->baldes[b].fichas = capacidade_balde;
+        sessao->baldes[b].tique = sessao->atividade;
+    }
+    sessao->ociosidade.tipo = TEMPORIZADOR_OCIOSIDADE;
+    sessao->retomada.tipo = TEMPORIZADOR_RETOMADA;
+    sessao->retrato.tipo = TEMPORIZADOR_RETRATO;
+    if (ociosidade_tiques) armaTemporizador(roda_thread, &sessao->ociosidade, sessao->atividade + ociosidade_tiques);
+    somaSessoes(1);
+    return sessao;
+}
+
+// Partida nova: o cliente também descartou o seu mapa (protocolo.h). Recriado no próximo
+// mapa incremental, já com as dimensões do labirinto da vez
+static void esqueceReveladas(Sessao *sessao) {
+    free(sessao->reveladas);
+    sessao->reveladas = NULL;
+}
+
+// Troca o labirinto da sessão, devolvendo ao cache o anterior se ele foi gerado
+static void trocaLabirinto(Sessao *sessao, const Labirinto *lab) {
+    if (sessao->labirinto != sessao->padrao) devolveLabirintoGerado(sessao->labirinto);
+    esqueceReveladas(sessao);
+    sessao->labirinto = lab;
+    sessao->semente = 0;
+    sessao->movimentos = 0;
+    sessao->player_pos[0] = lab->entrada[0];
+    sessao->player_pos[1] = lab->entrada[1];
+}
+
+// Passa a sessão para outra versão do labirinto do arquivo, da qual já tem uma referência,
+// no início dela; a versão anterior é devolvida
+static void trocaPadrao(Sessao *sessao, const Labirinto *versao) {
+    const Labirinto *anterior = sessao->padrao;
+    trocaLabirinto(sessao, versao);
+    sessao->padrao = versao;
+    devolveLabirinto(anterior);
+}
+
+// Pedido de início com lado e semente: o labirinto já foi preparado no cache (reservaGerado),
+// a não ser que tenha sido recusado
+static void iniciaLabirintoGerado(Sessao *sessao, const uint8_t *carga) {
+    int lado = leU16(carga);
+    uint64_t semente = leU64(carga + 2);
+    const Labirinto *lab = obtemLabirintoGerado(lado, semente);
+    if (!lab) return; // Continua no labirinto atual
+    trocaLabirinto(sessao, lab);
+    sessao->semente = semente;
+}
+
+// Retrato da partida da sessão. O conjunto de reveladas passa para o retrato quando a sessão
+// deixa a partida; nos retratos periódicos é copiado
+static Snapshot *retratoSessao(Sessao *sessao, bool transfere) {
+    Snapshot *snap = calloc(1, sizeof(Snapshot));
+    if (!snap) return NULL;
+    const Labirinto *lab = sessao->labirinto;
+    snap->token = sessao->token;
+    snap->lado = lab != sessao->padrao ? (uint16_t)lab->linhas : 0;
+    snap->semente = sessao->semente;
+    snap->linha = (uint16_t)sessao->player_pos[0];
+    snap->coluna = (uint16_t)sessao->player_pos[1];
+    snap->movimentos = sessao->movimentos;
+    if (sessao->reveladas) {
+        snap->palavras = ((size_t)lab->linhas * lab->colunas + 63) / 64;
+        if (transfere) {
+            snap->reveladas = sessao->reveladas;
+            sessao->reveladas = NULL;
+        } else if ((snap->reveladas = malloc(snap->palavras * sizeof(uint64_t)))) {
+            memcpy(snap->reveladas, sessao->reveladas, snap->palavras * sizeof(uint64_t));
+        } else {
+            free(snap);
+            return NULL;
+        }
+    }
+    return snap;
+}
+
+// Guarda a partida da sessão sob o seu token, para ser retomada
+static void salvaSessao(Sessao *sessao) {
+    Snapshot *snap = retratoSessao(sessao, true);
+    if (snap) guardaSnapshot(snap);
+}
+
+#define RETRATO_TIQUES (1000 / TIQUE_MS) // Intervalo mínimo entre retratos periódicos
+
+// Pedidos que mudam o que fica guardado da partida
+static bool mudaPartida(uint8_t opcode) {
+    return opcode != ACTION_HINT && opcode != ACTION_EXIT;
+}
+
+// A partida mudou: um retrato sai no máximo a cada RETRATO_TIQUES para que ela volte depois
+// de uma queda do servidor. Fica na tabela marcado como ativo, sem poder ser retomado
+static void agendaRetrato(Sessao *sessao) {
+    if (sessao->token && walAtivo() && !temporizadorArmado(&sessao->retrato)) {
+        armaTemporizador(roda_thread, &sessao->retrato, roda_thread->tique + RETRATO_TIQUES);
+    }
+}
+
+// Troca a partida atual pela guardada sob `token`, sem recalcular nada do tabuleiro.
+// Retorna 0 se o token não existe ou a partida não vale mais (labirinto diferente)
+static int retomaSessao(Sessao *sessao, uint64_t token) {
+    Snapshot *snap = retiraSnapshot(token);
+    if (!snap) return 0;
+
+    const Labirinto *lab = sessao->padrao;
+    if (snap->lado != 0) {
+        lab = obtemLabirintoGerado(snap->lado, snap->semente);
+        if (!lab) {
+            guardaSnapshot(snap); // Fica para uma próxima tentativa
+            return 0;
+        }
+    }
+    if (snap->linha >= lab->linhas || snap->coluna >= lab->colunas || !celulaLivre(lab, snap->linha, snap->coluna)) {
+        if (lab != sessao->padrao) devolveLabirintoGerado(lab);
+        liberaSnapshot(snap);
+        return 0;
+    }
+
+    // A partida atual também fica guardada, se tiver token
+    if (sessao->token && sessao->token != token) salvaSessao(sessao);
+    saiSala(sessao);
+    trocaLabirinto(sessao, lab);
+    sessao->token = token;
+    sessao->semente = snap->semente;
+    sessao->movimentos = snap->movimentos;
+    sessao->player_pos[0] = snap->linha;
+    sessao->player_pos[1] = snap->coluna;
+    if (snap->palavras == ((size_t)lab->linhas * lab->colunas + 63) / 64) {
+        sessao->reveladas = snap->reveladas;
+        snap->reveladas = NULL;
+    }
+    liberaSnapshot(snap);
+    return 1;
+}
+
+static void enviaRetomada(Anel *saida, int retomou, Sessao *sessao) {
+    uint8_t carga[RETOMADA_TAMANHO];
+    const Labirinto *lab = sessao->labirinto;
+    carga[0] = (uint8_t)retomou;
+    escreveU16(carga + 1, lab->linhas);
+    escreveU16(carga + 3, lab->colunas);
+    escreveU16(carga + 5, sessao->player_pos[0]);
+    escreveU16(carga + 7, sessao->player_pos[1]);
+    escreveU32(carga + 9, sessao->movimentos);
+    carga[13] = movimentosValidos(lab, sessao->player_pos);
+    enviaQuadro(saida, ACTION_RESUME, carga, sizeof(carga));
+}
+
+// Pedido de entrada em sala. A sessão passa para o labirinto da sala, na entrada, com uma
+// referência própria ao labirinto gerado (sempre um acerto, já que a sala guarda outra)
+static void entraNaSala(Sessao *sessao, const uint8_t *carga, uint32_t tamanho) {
+    uint32_t id = leU32(carga);
+    bool espectador = carga[4] == SALA_ESPECTADOR;
+    saiSala(sessao);
+    if (id != 0) {
+        int lado = 0;
+        uint64_t semente = 0;
+        if (tamanho >= ENTRADA_SALA + INICIO_GERADO) {
+            lado = leU16(carga + ENTRADA_SALA);
+            semente = leU64(carga + ENTRADA_SALA + 2);
+        }
+        Sala *sala = abreSala(id, lado, semente, sessao->padrao);
+        if (sala) {
+            const Labirinto *lab = labirintoSala(sala, &lado, &semente);
+            if (lado) lab = obtemLabirintoGerado(lado, semente);
+            else if (lab != sessao->padrao) retemLabirinto(lab); // Sala aberta em outra versão do arquivo
+
+            // A sala registra a sessão já na entrada do seu labirinto, mas a partida só é trocada
+            // depois da inscrição: com a sala cheia a sessão continua onde estava
+            int posicao[2] = {sessao->player_pos[0], sessao->player_pos[1]};
+            sessao->player_pos[0] = lab->entrada[0];
+            sessao->player_pos[1] = lab->entrada[1];
+            if (inscreveSala(sessao, sala, espectador) == 0) {
+                if (!lado && lab != sessao->padrao) trocaPadrao(sessao, lab); // Fica com a referência
+                trocaLabirinto(sessao, lab);
+                sessao->semente = semente;
+                return;
+            }
+            sessao->player_pos[0] = posicao[0];
+            sessao->player_pos[1] = posicao[1];
+            if (lado) devolveLabirintoGerado(lab);
+            else if (lab != sessao->padrao) devolveLabirinto(lab);
+        }
+    }
+    enviaQuadro(&sessao->saida, ACTION_ROOM, NULL, 0);
+}
+
+void liberaSessao(Sessao *sessao) {
+    if (gravador_thread) gravaFechamento(sessao);
+    desarmaTemporizador(roda_thread, &sessao->ociosidade);
+    desarmaTemporizador(roda_thread, &sessao->retomada);
+    desarmaTemporizador(roda_thread, &sessao->retrato);
+    saiSala(sessao);
+    liberaFilaBlocos(&sessao->blocos);
+    if (sessao->token) salvaSessao(sessao);
+    if (sessao->labirinto != sessao->padrao) devolveLabirintoGerado(sessao->labirinto);
+    devolveLabirinto(sessao->padrao);
+    free(sessao->reveladas);
+    liberaAnel(&sessao->entrada);
+    liberaAnel(&sessao->saida);
+    liberaAnel(&sessao->enviando);
+    poolLibera(&sessao->recursos->sessoes, sessao);
+    somaSessoes(-1);
+}
+
+// Trata um quadro completo. Retorna 0 se o cliente pediu para sair
+int processaAcao(Sessao *sessao, uint8_t opcode, const uint8_t *carga, uint32_t tamanho) {
+    Anel *saida = &sessao->saida;
+    const Labirinto *lab = sessao->labirinto;
+    int *player_pos = sessao->player_pos;
+    bool espectador = sessao->sala && sessao->id_sala == SALA_SEM_ID; // Não se move
+
+    switch (opcode) {
+        case ACTION_START:
+            registraLog("starting new game\n");
+            saiSala(sessao);
+            esqueceReveladas(sessao);
+            if (tamanho >= INICIO_GERADO) iniciaLabirintoGerado(sessao, carga);
+            else if (labirintoSubstituido(sessao->padrao)) trocaPadrao(sessao, obtemLabirintoAtual());
+            else if (lab != sessao->padrao) trocaLabirinto(sessao, sessao->padrao);
+            enviaMovimentos(saida, movimentosValidos(sessao->labirinto, player_pos));
+            break;
+
+        case ACTION_MOVE:
+            if (tamanho >= 1 && carga[0] >= 1 && carga[0] <= 4 && !espectador) {
+                int antes[2] = {player_pos[0], player_pos[1]};
+                int verifica = atualizaPosicaoJogador(lab, &player_pos[0], &player_pos[1], carga[0]);
+                if (antes[0] != player_pos[0] || antes[1] != player_pos[1]) {
+                    sessao->movimentos++;
+                    moveNaSala(sessao);
+                }
+                if(verifica==0){
+                    enviaMapaCompleto(saida, lab);
+                    break;
+                }
+            }
+            enviaMovimentos(saida, espectador ? 0 : movimentosValidos(lab, player_pos));
+            break;
+
+        case ACTION_MOVE_BATCH: {
+            // Toda ACTION_MOVE_BATCH tem resposta, mesmo sem a contagem: clientes com pedidos em
+            // sequência casam respostas e pedidos pela ordem
+            uint16_t pedidos = tamanho >= 2 ? leU16(carga) : 0;
+            if (pedidos > 0 && tamanhoDirecoes(pedidos) > tamanho - 2) pedidos = (tamanho - 2) * 4; // Carga truncada
+            if (espectador) pedidos = 0;
+            uint16_t aplicados = 0;
+            int venceu = 0;
+            while (aplicados < pedidos && !venceu) {
+                int direcao = desempacotaDirecao(carga + 2, aplicados);
+                if (!(movimentosValidos(lab, player_pos) & MOVIMENTO_BIT(direcao))) break;
+                venceu = !atualizaPosicaoJogador(lab, &player_pos[0], &player_pos[1], direcao);
+                aplicados++;
+            }
+            sessao->movimentos += aplicados;
+            if (aplicados > 0) moveNaSala(sessao);
+            enviaMovido(saida, aplicados, player_pos, espectador ? 0 : movimentosValidos(lab, player_pos), venceu);
+            break;
+        }
+
+        case ACTION_MAP:
+            if (tamanho >= 1 && carga[0] == MAPA_INCREMENTAL) {
+                if (!sessao->reveladas) {
+                    size_t total = (size_t)lab->linhas * lab->colunas;
+                    sessao->reveladas = calloc((total + 63) / 64, sizeof(uint64_t));
+                }
+                if (sessao->reveladas) {
+                    enviaMapaIncremental(saida, lab, sessao->reveladas, player_pos[0], player_pos[1]);
+                    break;
+                }
+            }
+            enviaMapa(saida, lab, sessao->reveladas, player_pos[0], player_pos[1]);
+            break;
+
+        case ACTION_HINT: {
+            // Área da busca e caminho vêm da arena do pedido, já com a capacidade máxima
+            // (um caminho mínimo nunca passa duas vezes pela mesma célula)
+            Arena *arena = &sessao->recursos->arena;
+            size_t total = (size_t)lab->linhas * lab->colunas;
+            int motor = motor_dica == MOTOR_TABELA && !lab->proximo ? MOTOR_BFS : motor_dica;
+            Caminho dica = {arenaAloca(arena, total), 0, total};
+            AreaBusca busca = {0};
+            int resultado = -1;
+            if (dica.passos && motor != MOTOR_TABELA) {
+                busca.direcao = arenaAloca(arena, total);
+                busca.fila = arenaAloca(arena, total * filasMotor(motor) * sizeof(int32_t));
+                if (usaCusto(motor)) busca.custo = arenaAloca(arena, total * sizeof(int32_t));
+                busca.capacidade = total;
+                if (!busca.direcao || !busca.fila || (usaCusto(motor) && !busca.custo)) dica.passos = NULL;
+            }
+            if (dica.passos) resultado = buscaComMotor(motor, lab, player_pos[0], player_pos[1], &busca, &dica);
+            if (metricas_thread) {
+                if (motor == MOTOR_TABELA) somaContador(&metricas_thread->passos_dica, dica.tamanho);
+                else somaContador(&metricas_thread->nos_expandidos, busca.expandidos);
+            }
+            if (resultado == -1) {
+                registraLog("Memória insuficiente para calcular a dica\n");
+                dica.tamanho = 0;
+            }
+            enviaDica(saida, &dica);
+            break;
+        }
+
+        case ACTION_RESET:
+            registraLog("starting new game\n");
+            // Fora de sala, o recomeço no labirinto do arquivo já usa a versão recarregada
+            if (!sessao->sala && lab == sessao->padrao && labirintoSubstituido(lab)) {
+                trocaPadrao(sessao, obtemLabirintoAtual());
+                lab = sessao->labirinto;
+            }
+            esqueceReveladas(sessao);
+            if (!espectador) {
+                player_pos[0] = lab->entrada[0];
+                player_pos[1] = lab->entrada[1];
+                sessao->movimentos = 0;
+                moveNaSala(sessao);
+            }
+            enviaMovimentos(saida, espectador ? 0 : movimentosValidos(lab, player_pos));
+            break;
+
+        case ACTION_TOKEN: {
+            if (!sessao->token) sessao->token = novoToken();
+            uint8_t token[8];
+            escreveU64(token, sessao->token);
+            enviaQuadro(saida, ACTION_TOKEN, token, sizeof(token));
+            break;
+        }
+
+        case ACTION_RESUME:
+            enviaRetomada(saida, tamanho >= 8 && retomaSessao(sessao, leU64(carga)), sessao);
+            break;
+
+        case ACTION_JOIN:
+            if (tamanho >= ENTRADA_SALA) entraNaSala(sessao, carga, tamanho);
+            else enviaQuadro(saida, ACTION_ROOM, NULL, 0);
+            break;
+
+        case ACTION_EXIT:
+            registraLog("client disconnected\n");
+            return 0;
+
+        default:
+            break;
+    }
+    return 1;
+}
+
+// Tira uma ficha do balde de ACTION_HINT ou ACTION_MAP, repondo antes o que o tempo desde a
+// última reposição rendeu. Sem ficha, o pedido espera no anel e o temporizador da sessão é
+// armado para quando houver uma; os outros opcodes nunca esperam
+static bool consomeFicha(Sessao *sessao, uint8_t opcode) {
+    if (reposicao_tique == 0 || (opcode != ACTION_HINT && opcode != ACTION_MAP)) return true;
+    BaldeFichas *balde = &sessao->baldes[opcode == ACTION_HINT ? BALDE_DICA : BALDE_MAPA];
+    uint64_t agora = roda_thread->tique;
+    uint64_t fichas = balde->fichas + (agora - balde->tique) * reposicao_tique;
+    balde->fichas = fichas < capacidade_balde ? (uint32_t)fichas : capacidade_balde;
+    balde->tique = agora;
+    if (balde->fichas >= FICHA) {
+        balde->fichas -= FICHA;
+        return true;
+    }
+    sessao->adiada = true;
+    armaTemporizador(roda_thread, &sessao->retomada, agora + (FICHA - balde->fichas + reposicao_tique - 1) / reposicao_tique);
+    if (metricas_thread) somaContador(&metricas_thread->pedidos_limitados, 1);
+    return false;
+}
+
+// Labirinto gerado de que o pedido vai precisar: o de START com semente, o de uma sala que
+// ainda não existe ou o da partida a retomar. Retorna false se o pedido não gera nada
+static bool geradoDoPedido(uint8_t opcode, const uint8_t *carga, uint32_t tamanho, int *lado, uint64_t *semente) {
+    uint16_t lado_retrato;
+    switch (opcode) {
+        case ACTION_START:
+            if (tamanho < INICIO_GERADO) return false;
+            *lado = leU16(carga);
+            *semente = leU64(carga + 2);
+            return true;
+        case ACTION_JOIN:
+            if (tamanho < ENTRADA_SALA + INICIO_GERADO || leU32(carga) == 0 || salaAberta(leU32(carga))) return false;
+            *lado = leU16(carga + ENTRADA_SALA);
+            *semente = leU64(carga + ENTRADA_SALA + 2);
+            return *lado != 0;
+        case ACTION_RESUME:
+            if (tamanho < 8 || !consultaSnapshot(leU64(carga), &lado_retrato, semente) || lado_retrato == 0) return false;
+            *lado = lado_retrato;
+            return true;
+        default:
+            return false;
+    }
+}
+
+// O worker nunca gera labirintos: o pedido que precisa de um que não está no cache espera no
+// anel, como o que espera ficha, e é retomado a cada tique até a thread de geração terminar.
+// Pronto, o labirinto fica com uma referência em `*reservado` até o fim do pedido, para não
+// sair do cache no meio dele. Um pedido recusado segue sem labirinto, como sem memória
+static bool reservaGerado(Sessao *sessao, uint8_t opcode, const uint8_t *carga, uint32_t tamanho, const Labirinto **reservado) {
+    int lado;
+    uint64_t semente;
+    if (!geradoDoPedido(opcode, carga, tamanho, &lado, &semente)) return true;
+    int estado = preparaLabirintoGerado(lado, semente, reservado);
+    bool esperou = sessao->espera_gerado != 0;
+    if (metricas_thread) {
+        if (estado == GERADO_NOVO) somaContador(&metricas_thread->labirintos_gerados, 1);
+        else if (estado == GERADO_RECUSADO) somaContador(&metricas_thread->labirintos_recusados, 1);
+        else if (estado == GERADO_PRONTO && !esperou) somaContador(&metricas_thread->cache_acertos, 1);
+    }
+    if (estado == GERADO_PRONTO || estado == GERADO_RECUSADO) {
+        if (estado == GERADO_RECUSADO) {
+            registraLog("labirinto %d/%llu recusado (limite de -G ou sem memória)\n", lado, (unsigned long long)semente);
+        } else if (esperou) {
+            registraLog("labirinto %dx%d (semente %llu) pronto em %.1f ms\n", (*reservado)->linhas, (*reservado)->colunas,
+                        (unsigned long long)semente, (agoraNs() - sessao->espera_gerado) / 1e6);
+        }
+        sessao->espera_gerado = 0;
+        return true;
+    }
+    if (!esperou) sessao->espera_gerado = agoraNs();
+    sessao->adiada = true;
+    armaTemporizador(roda_thread, &sessao->retomada, roda_thread->tique);
+    return false;
+}
+
+int disparaTemporizador(Temporizador *t, Sessao **saida) {
+    size_t deslocamento = t->tipo == TEMPORIZADOR_RETOMADA ? offsetof(Sessao, retomada)
+                          : t->tipo == TEMPORIZADOR_RETRATO  ? offsetof(Sessao, retrato)
+                                                             : offsetof(Sessao, ociosidade);
+    Sessao *sessao = *saida = (Sessao *)((char *)t - deslocamento);
+    if (sessao->encerrar) return TEMPORIZADOR_NADA;
+
+    if (t->tipo == TEMPORIZADOR_RETRATO) {
+        Snapshot *snap = sessao->token ? retratoSessao(sessao, false) : NULL;
+        if (snap) {
+            snap->ativa = true;
+            guardaSnapshot(snap);
+        }
+        return TEMPORIZADOR_NADA;
+    }
+
+    if (t->tipo == TEMPORIZADOR_RETOMADA) {
+        sessao->adiada = false;
+        return processaEntrada(sessao) ? TEMPORIZADOR_DESCARREGA : TEMPORIZADOR_ENCERRA;
+    }
+    // A atividade só adia o prazo; o temporizador é rearmado quando vence, não a cada pedido
+    uint64_t prazo = sessao->atividade + ociosidade_tiques;
+    if (prazo > roda_thread->tique) {
+        armaTemporizador(roda_thread, t, prazo);
+        return TEMPORIZADOR_NADA;
+    }
+    registraLog("sessão ociosa encerrada\n");
+    if (metricas_thread) somaContador(&metricas_thread->sessoes_ociosas, 1);
+    return TEMPORIZADOR_ENCERRA;
+}
+
+// Trata os quadros completos do anel de entrada. Para quando as respostas pendentes passam
+// de SAIDA_ALTA, um pedido limitado fica sem ficha ou um labirinto gerado ainda não está
+// pronto; os quadros restantes esperam no anel. Retorna 0 se a sessão deve ser encerrada
+int processaEntrada(Sessao *sessao) {
+    Anel *entrada = &sessao->entrada;
+    uint8_t copia[CABECALHO_TAMANHO + MAX_CARGA_PEDIDO];
+    while (entrada->tamanho >= CABECALHO_TAMANHO && !sessao->adiada) {
+        if (pendentesSaida(sessao) >= SAIDA_ALTA) {
+            sessao->pausada = true;
+            return 1;
+        }
+
+        uint8_t cabecalho[CABECALHO_TAMANHO];
+        anelCopia(entrada, 0, cabecalho, sizeof(cabecalho));
+        uint32_t tamanho = leU32(cabecalho + 2);
+        if (cabecalho[0] != PROTOCOLO_VERSAO || tamanho > MAX_CARGA_PEDIDO) {
+            registraLog("Quadro inválido recebido\n");
+            return 0;
+        }
+        if (entrada->tamanho < CABECALHO_TAMANHO + tamanho) break;
+
+        // Só quadros que dão a volta no fim do anel são copiados
+        const uint8_t *quadro = anelContiguo(entrada, 0, CABECALHO_TAMANHO + tamanho);
+        if (!quadro) {
+            anelCopia(entrada, 0, copia, CABECALHO_TAMANHO + tamanho);
+            quadro = copia;
+        }
+        if (!consomeFicha(sessao, cabecalho[1])) break;
+        const Labirinto *reservado = NULL;
+        if (!reservaGerado(sessao, quadro[1], quadro + CABECALHO_TAMANHO, tamanho, &reservado)) break;
+        registraAtividade(sessao);
+
+        uint64_t comeco = agoraNs();
+        size_t saida_antes = sessao->saida.tamanho;
+        int continua = processaAcao(sessao, quadro[1], quadro + CABECALHO_TAMANHO, tamanho);
+        if (mudaPartida(quadro[1])) agendaRetrato(sessao);
+        if (reservado) devolveLabirintoGerado(reservado);
+        if (gravador_thread) gravaPedido(sessao, quadro[1], quadro + CABECALHO_TAMANHO, tamanho, saida_antes, comeco);
+        arenaReinicia(&sessao->recursos->arena);
+        if (metricas_thread) registraPedido(metricas_thread, quadro[1], agoraNs() - comeco);
+        anelConsome(entrada, CABECALHO_TAMANHO + tamanho);
+        if (!continua || sessao->saida.erro) return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,138 @@
+#ifndef SESSAO_H
+#define SESSAO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "labirinto.h"
+#include "busca.h"
+#include "anel.h"
+#include "pool.h"
+#include "metricas.h"
+#include "sala.h"
+#include "temporizador.h"
+
+// Estado e regras de uma partida, independentes do transporte: os pedidos chegam pelo anel
+// de entrada e as respostas vão para o anel de saída. Cada transporte (epoll, io_uring) só
+// move bytes entre os anéis e o socket.
+
+#define ENTRADA_CAPACIDADE 4096 // Anel de entrada: cabe ao menos um quadro de tamanho máximo
+#define SAIDA_ALTA (256 * 1024) // Acima disso a sessão para de ler pedidos até o cliente consumir as respostas
+#define SAIDA_BAIXA (64 * 1024) // Abaixo disso a leitura volta
+#define SAIDA_RETIDA (64 * 1024) // Maior anel de saída mantido entre rajadas
+
+// Alocadores do worker para as sessões; nada disso é alocado por pedido depois do aquecimento
+typedef struct {
+    Pool sessoes;
+    Pool buffers; // Anéis de entrada, e os de saída enquanto não crescem além de um bloco
+    Arena arena;  // Rascunho de um pedido: área da busca, dica e cargas das respostas grandes
+} RecursosSessao;
+
+// Balde de fichas de um pedido caro, em milésimos de ficha para a reposição ser inteira
+typedef struct {
+    uint32_t fichas;
+    uint64_t tique; // Última reposição
+} BaldeFichas;
+
+#define BALDE_DICA 0 // ACTION_HINT
+#define BALDE_MAPA 1 // ACTION_MAP
+#define NUM_BALDES 2
+
+#define TEMPORIZADOR_OCIOSIDADE 0
+#define TEMPORIZADOR_RETOMADA 1
+#define TEMPORIZADOR_RETRATO 2
+
+// Recursos do worker da thread atual; precisa estar definido para criar sessões
+extern _Thread_local RecursosSessao *recursos_thread;
+
+void iniciaRecursosSessao(RecursosSessao *recursos, Metricas *metricas);
+
+// Estado de uma partida: o labirinto é compartilhado, a posição é só da sessão
+typedef struct Sessao {
+    int socket;
+    RecursosSessao *recursos; // Pools de onde a sessão e seus anéis vieram
+    const Labirinto *labirinto;
+    const Labirinto *padrao; // Versão do labirinto do arquivo (-i), com referência (recarga.h)
+    int player_pos[2];
+    // Células já enviadas no modo incremental, um bit por célula. Alocado no primeiro
+    // pedido; o calloc grande vem de páginas zeradas sob demanda, então só as regiões
+    // visitadas ocupam memória
+    uint64_t *reveladas;
+    uint64_t semente;     // Semente do labirinto gerado (lado = linhas do labirinto)
+    uint32_t movimentos;  // Passos dados na partida atual
+    uint64_t token;       // 0 até o cliente pedir um; com token a partida é guardada ao sair
+    uint32_t id_gravacao; // Número da sessão no arquivo de gravação (0 antes do primeiro registro)
+    Anel entrada;     // Bytes recebidos ainda não tratados (quadros podem chegar aos pedaços)
+    Anel saida;       // Respostas ainda não aceitas pelo kernel
+    bool pausada;     // Leitura suspensa porque o cliente não está consumindo as respostas
+    bool encerrar;    // Fechar no fim da iteração do laço de eventos
+
+    // Ociosidade e limite de pedidos caros, na roda de temporização do worker
+    Temporizador ociosidade; // Encerra a sessão sem pedidos nem respostas consumidas
+    Temporizador retomada;   // Volta ao pedido adiado quando ele tiver ficha ou labirinto
+    Temporizador retrato;    // Com token e -w: guarda a partida alterada no WAL (persistencia.h)
+    uint64_t atividade;      // Tique do último pedido tratado ou envio aceito
+    bool adiada;             // Pedido no início do anel esperando ficha ou labirinto gerado
+    uint64_t espera_gerado;  // Início da espera pelo labirinto gerado (ns); 0 sem espera
+    BaldeFichas baldes[NUM_BALDES];
+
+    // Sala (sala.h)
+    Sala *sala;              // NULL fora de sala
+    uint16_t id_sala;        // Jogador na sala; SALA_SEM_ID para espectadores
+    bool dessincronizada;    // Perdeu blocos por atraso; recebe o estado inteiro quando drenar
+    FilaBlocos blocos;       // Blocos da sala a enviar, sem cópia
+    struct GrupoSala *grupo; // Inscritos da mesma sala neste worker
+    struct Sessao *inscrito_anterior, *inscrito_proximo;
+
+    // Estado de cada transporte
+    bool marcada;           // Já está na lista de sessões a descarregar nesta volta
+    struct Sessao *proxima; // Próxima sessão da lista
+    uint32_t interesse;     // epoll: eventos registrados
+    Anel enviando;          // io_uring: respostas entregues ao kernel; `saida` recebe as novas
+    size_t blocos_lote;     // io_uring: blocos do início da fila que estão com o kernel
+    int envios;             // io_uring: envios sem conclusão
+    uint8_t recepcao;       // io_uring: estado do recv multishot (RECEPCAO_*)
+} Sessao;
+
+#define RECEPCAO_PARADA 0
+#define RECEPCAO_ATIVA 1
+#define RECEPCAO_CANCELANDO 2
+
+// Bytes de resposta que o cliente ainda não recebeu
+static inline size_t pendentesSaida(const Sessao *sessao) {
+    return sessao->saida.tamanho + sessao->enviando.tamanho + sessao->blocos.bytes;
+}
+
+// Leitura parada: respostas acumuladas (pausada) ou pedido adiado (adiada)
+static inline bool leituraSuspensa(const Sessao *sessao) {
+    return sessao->pausada || sessao->adiada;
+}
+
+// Pedido tratado ou resposta aceita pelo kernel: adia o encerramento por ociosidade
+static inline void registraAtividade(Sessao *sessao) {
+    sessao->atividade = roda_thread->tique;
+}
+
+uint64_t agoraNs(void);
+
+// Motor de busca usado nas dicas (MOTOR_TABELA por padrão); antes das threads começarem
+void configuraMotorDica(int motor);
+// Segundos sem atividade até a sessão ser encerrada (0: nunca) e ACTION_HINT e ACTION_MAP
+// aceitos por segundo em cada sessão, com rajada de até `rajada` pedidos (taxa 0: sem limite)
+void configuraLimites(unsigned ociosidade_s, unsigned taxa, unsigned rajada);
+
+// Temporizador da sessão vencido na roda do worker. Diz ao transporte o que fazer com a sessão
+#define TEMPORIZADOR_NADA 0
+#define TEMPORIZADOR_DESCARREGA 1 // Pedidos retomados; há respostas a enviar
+#define TEMPORIZADOR_ENCERRA 2    // Sessão ociosa, ou um pedido retomado pediu para sair
+int disparaTemporizador(Temporizador *t, Sessao **sessao);
+
+// A sessão começa na versão atual do labirinto do arquivo. NULL sem memória
+Sessao *criaSessao(int client_socket);
+// Libera os recursos da sessão; fechar o socket fica com o transporte
+void liberaSessao(Sessao *sessao);
+
+int processaAcao(Sessao *sessao, uint8_t opcode, const uint8_t *carga, uint32_t tamanho);
+int processaEntrada(Sessao *sessao);
+
+#endif
@@ -0,0 +1,113 @@
+#include "temporizador.h"
+
+_Thread_local RodaTempo *roda_thread;
+
+void iniciaRoda(RodaTempo *roda, uint64_t agora_ns) {
+    for (int n = 0; n < NIVEIS_RODA; n++) {
+        for (int s = 0; s < SLOTS_RODA; s++) roda->slots[n][s].anterior = roda->slots[n][s].proximo = &roda->slots[n][s];
+        roda->armados[n] = 0;
+    }
+    roda->tique = tiqueDe(agora_ns);
+}
+
+// Nível pela distância até o prazo; a posição vem dos bits do próprio prazo, então um
+// temporizador do nível n desce no tique em que os n níveis de baixo voltam a zero
+static void insere(RodaTempo *roda, Temporizador *t) {
+    uint64_t prazo = t->prazo < roda->tique ? roda->tique : t->prazo;
+    uint64_t distancia = prazo - roda->tique;
+    int nivel = 0;
+    while (nivel < NIVEIS_RODA - 1 && distancia >= (1ull << (BITS_SLOTS * (nivel + 1)))) nivel++;
+    if (distancia >= (1ull << (BITS_SLOTS * NIVEIS_RODA))) prazo = roda->tique + (1ull << (BITS_SLOTS * NIVEIS_RODA)) - 1;
+
+    Temporizador *cabeca = &roda->slots[nivel][(prazo >> (BITS_SLOTS * nivel)) & (SLOTS_RODA - 1)];
+    t->nivel = (uint8_t)nivel;
+    t->proximo = cabeca;
+    t->anterior = cabeca->anterior;
+    cabeca->anterior->proximo = t;
+    cabeca->anterior = t;
+    roda->armados[nivel]++;
+}
+
+static void retira(RodaTempo *roda, Temporizador *t) {
+    t->anterior->proximo = t->proximo;
+    t->proximo->anterior = t->anterior;
+    t->anterior = t->proximo = NULL;
+    roda->armados[t->nivel]--;
+}
+
+void armaTemporizador(RodaTempo *roda, Temporizador *t, uint64_t prazo) {
+    if (temporizadorArmado(t)) retira(roda, t);
+    t->prazo = prazo;
+    insere(roda, t);
+}
+
+void desarmaTemporizador(RodaTempo *roda, Temporizador *t) {
+    if (temporizadorArmado(t)) retira(roda, t);
+}
+
+// Reinsere a posição inteira a partir do tique atual: tudo cai em níveis mais baixos
+static void cascata(RodaTempo *roda, int nivel, int slot) {
+    Temporizador *cabeca = &roda->slots[nivel][slot];
+    while (cabeca->proximo != cabeca) {
+        Temporizador *t = cabeca->proximo;
+        retira(roda, t);
+        insere(roda, t);
+    }
+}
+
+void avancaRoda(RodaTempo *roda, uint64_t agora_ns, void (*dispara)(void *contexto, Temporizador *t), void *contexto) {
+    uint64_t agora = tiqueDe(agora_ns);
+    while (roda->tique <= agora) {
+        size_t total = 0;
+        for (int n = 0; n < NIVEIS_RODA; n++) total += roda->armados[n];
+        if (total == 0) {
+            roda->tique = agora + 1; // Nada armado: não há por que visitar cada tique
+            return;
+        }
+
+        uint64_t t = roda->tique;
+        for (int n = 1; n < NIVEIS_RODA; n++) {
+            if (t & ((1ull << (BITS_SLOTS * n)) - 1)) break;
+            cascata(roda, n, (int)((t >> (BITS_SLOTS * n)) & (SLOTS_RODA - 1)));
+        }
+
+        // A posição é esvaziada antes dos disparos: o que for rearmado agora vai para tiques seguintes
+        Temporizador vencidos, *cabeca = &roda->slots[0][t & (SLOTS_RODA - 1)];
+        vencidos.proximo = vencidos.anterior = &vencidos;
+        if (cabeca->proximo != cabeca) {
+            vencidos.proximo = cabeca->proximo;
+            vencidos.anterior = cabeca->anterior;
+            vencidos.proximo->anterior = vencidos.anterior->proximo = &vencidos;
+            cabeca->proximo = cabeca->anterior = cabeca;
+        }
+        roda->tique = t + 1;
+        while (vencidos.proximo != &vencidos) {
+            Temporizador *v = vencidos.proximo;
+            retira(roda, v);
+            dispara(contexto, v);
+        }
+    }
+}
+
+int esperaRoda(const RodaTempo *roda, uint64_t agora_ns) {
+    uint64_t alvo = UINT64_MAX;
+    if (roda->armados[0] > 0) {
+        for (uint64_t t = roda->tique; t < roda->tique + SLOTS_RODA; t++) {
+            const Temporizador *cabeca = &roda->slots[0][t & (SLOTS_RODA - 1)];
+            if (cabeca->proximo != cabeca) {
+                alvo = t;
+                break;
+            }
+        }
+    }
+    for (int n = 1; n < NIVEIS_RODA; n++) {
+        if (roda->armados[n] == 0) continue;
+        uint64_t volta = (roda->tique + SLOTS_RODA - 1) & ~(uint64_t)(SLOTS_RODA - 1); // Próxima cascata
+        if (volta < alvo) alvo = volta;
+        break;
+    }
+    if (alvo == UINT64_MAX) return -1;
+    uint64_t inicio = alvo * TIQUE_MS * 1000000ull;
+    if (inicio <= agora_ns) return 0;
+    return (int)((inicio - agora_ns + 999999) / 1000000);
+}
@@ -0,0 +1,54 @@
+#ifndef TEMPORIZADOR_H
+#define TEMPORIZADOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Roda de temporização hierárquica de um worker (Varghese e Lauck): NIVEIS_RODA níveis de
+// SLOTS_RODA posições. O nível 0 tem uma posição por tique; cada posição do nível n cobre
+// uma volta inteira do nível n - 1 e desce em cascata quando o nível de baixo dá a volta.
+// Armar e desarmar são O(1), com listas duplamente encadeadas dentro dos próprios
+// temporizadores, e nenhum temporizador é visitado antes de chegar perto do prazo.
+
+#define TIQUE_MS 10
+#define BITS_SLOTS 6
+#define SLOTS_RODA (1 << BITS_SLOTS)
+#define NIVEIS_RODA 4 // 64^4 tiques de 10 ms: prazos de até ~194 dias
+
+typedef struct Temporizador {
+    struct Temporizador *anterior, *proximo; // NULL quando desarmado
+    uint64_t prazo; // Em tiques
+    uint8_t nivel;
+    uint8_t tipo;   // Quem arma decide o que o disparo significa
+} Temporizador;
+
+typedef struct {
+    Temporizador slots[NIVEIS_RODA][SLOTS_RODA]; // Cabeças das listas circulares
+    size_t armados[NIVEIS_RODA];
+    uint64_t tique; // Próximo tique a processar
+} RodaTempo;
+
+// Roda do worker da thread atual
+extern _Thread_local RodaTempo *roda_thread;
+
+static inline uint64_t tiqueDe(uint64_t ns) {
+    return ns / (TIQUE_MS * 1000000ull);
+}
+
+static inline bool temporizadorArmado(const Temporizador *t) {
+    return t->proximo != NULL;
+}
+
+void iniciaRoda(RodaTempo *roda, uint64_t agora_ns);
+// Prazos já vencidos disparam no próximo avanço
+void armaTemporizador(RodaTempo *roda, Temporizador *t, uint64_t prazo);
+void desarmaTemporizador(RodaTempo *roda, Temporizador *t);
+
+// Processa os tiques até `agora_ns`, chamando `dispara` para cada temporizador vencido, já
+// desarmado (o callback pode armá-lo de novo)
+void avancaRoda(RodaTempo *roda, uint64_t agora_ns, void (*dispara)(void *contexto, Temporizador *t), void *contexto);
+// Milissegundos até o próximo tique com trabalho (disparo ou cascata); -1 sem temporizadores
+int esperaRoda(const RodaTempo *roda, uint64_t agora_ns);
+
+#endif
@@ -0,0 +1,468 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+
+#include "uring.h"
+#include "sessao.h"
+#include "metricas.h"
+#include "recarga.h"
+
+#define URING_ENTRADAS 4096    // Posições da fila de submissão
+#define URING_CONCLUSOES 16384 // Posições da fila de conclusão
+#define BUFFERS_RECEPCAO 4096  // Buffers fornecidos ao kernel (potência de 2)
+#define TAMANHO_BUFFER 2048    // Bytes por buffer de recepção
+#define GRUPO_BUFFERS 0
+
+// Os 3 bits baixos do user_data dizem a operação; o resto é o ponteiro da sessão (sessões
+// vêm de um pool alinhado a 64 bytes)
+#define OP_RECEPCAO 0
+#define OP_ENVIO 1
+#define OP_ACEITE 2
+#define OP_CANCELAMENTO 3
+#define OP_AVISO 4
+#define OP_MASCARA 7ull
+
+struct Uring {
+    int fd;
+    int server_socket;
+
+    // Fila de submissão
+    unsigned *sq_head, *sq_tail, *sq_array, sq_mascara, sq_entradas;
+    struct io_uring_sqe *sqes;
+    unsigned preparadas; // SQEs publicadas e ainda não submetidas
+
+    // Fila de conclusão
+    unsigned *cq_head, *cq_tail, cq_mascara;
+    struct io_uring_cqe *cqes;
+
+    // Anel de buffers fornecidos: o kernel escolhe um buffer livre a cada recepção
+    struct io_uring_buf_ring *buffers;
+    uint8_t *memoria_buffers;
+    uint16_t buffers_tail;
+
+    Sessao *marcadas; // Sessões tocadas nesta volta do laço
+
+    SalasWorker *salas;
+    uint64_t aviso; // Destino da leitura do eventfd das salas
+};
+
+static int uringSetup(unsigned entradas, struct io_uring_params *p) {
+    return (int)syscall(__NR_io_uring_setup, entradas, p);
+}
+
+static int uringEnter(int fd, unsigned submeter, unsigned minimo, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, submeter, minimo, flags, NULL, 0);
+}
+
+// Como uringEnter esperando uma conclusão, mas desiste depois de `espera_ms` (-1: sem limite)
+static int uringEspera(int fd, unsigned submeter, int espera_ms) {
+    if (espera_ms < 0) return uringEnter(fd, submeter, 1, IORING_ENTER_GETEVENTS);
+    struct __kernel_timespec ts = {espera_ms / 1000, (espera_ms % 1000) * 1000000ll};
+    struct io_uring_getevents_arg arg = {.ts = (uintptr_t)&ts};
+    return (int)syscall(__NR_io_uring_enter, fd, submeter, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+}
+
+static int uringRegister(int fd, unsigned opcode, void *arg, unsigned n) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, n);
+}
+
+// Submete as SQEs preparadas sem esperar conclusões (fila de submissão cheia)
+static void submete(Uring *u) {
+    while (u->preparadas > 0) {
+        int r = uringEnter(u->fd, u->preparadas, 0, 0);
+        if (r < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY) continue;
+            perror("Erro no io_uring_enter");
+            return;
+        }
+        u->preparadas -= r;
+    }
+}
+
+// Próxima SQE livre, já zerada. A SQE é publicada na hora; o kernel só a vê no próximo enter
+static struct io_uring_sqe *obtemSqe(Uring *u, uint64_t user_data) {
+    unsigned tail = *u->sq_tail;
+    if (tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) >= u->sq_entradas) submete(u);
+    unsigned indice = tail & u->sq_mascara;
+    struct io_uring_sqe *sqe = &u->sqes[indice];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->user_data = user_data;
+    u->sq_array[indice] = indice;
+    __atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    u->preparadas++;
+    return sqe;
+}
+
+static void armaAceite(Uring *u) {
+    struct io_uring_sqe *sqe = obtemSqe(u, OP_ACEITE);
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = u->server_socket;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+}
+
+static void armaAviso(Uring *u) {
+    struct io_uring_sqe *sqe = obtemSqe(u, OP_AVISO);
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = u->salas->aviso;
+    sqe->addr = (uintptr_t)&u->aviso;
+    sqe->len = sizeof(u->aviso);
+}
+
+static void armaRecepcao(Uring *u, Sessao *s) {
+    struct io_uring_sqe *sqe = obtemSqe(u, (uintptr_t)s | OP_RECEPCAO);
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = s->socket;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = GRUPO_BUFFERS;
+    s->recepcao = RECEPCAO_ATIVA;
+}
+
+static void cancelaRecepcao(Uring *u, Sessao *s) {
+    struct io_uring_sqe *sqe = obtemSqe(u, OP_CANCELAMENTO);
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = (uintptr_t)s | OP_RECEPCAO;
+    s->recepcao = RECEPCAO_CANCELANDO;
+}
+
+// As partes do anel e os blocos do lote em envios encadeados: cada um só começa depois do
+// anterior, e os seguintes são cancelados se um for curto
+static void armaEnvios(Uring *u, Sessao *s) {
+    struct iovec iov[TRECHOS_SAIDA];
+    int partes = trechosSaida(&s->enviando, &s->blocos, s->blocos_lote, iov);
+    for (int i = 0; i < partes; i++) {
+        struct io_uring_sqe *sqe = obtemSqe(u, (uintptr_t)s | OP_ENVIO);
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = s->socket;
+        sqe->addr = (uintptr_t)iov[i].iov_base;
+        sqe->len = (unsigned)iov[i].iov_len;
+        sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+        if (i + 1 < partes) sqe->flags = IOSQE_IO_LINK;
+        s->envios++;
+    }
+}
+
+static void devolveBuffer(Uring *u, uint16_t id) {
+    struct io_uring_buf *buf = &u->buffers->bufs[u->buffers_tail & (BUFFERS_RECEPCAO - 1)];
+    // Campo a campo: o tail do anel ocupa o `resv` da primeira posição
+    buf->addr = (uintptr_t)(u->memoria_buffers + (size_t)id * TAMANHO_BUFFER);
+    buf->len = TAMANHO_BUFFER;
+    buf->bid = id;
+    u->buffers_tail++;
+}
+
+static void marca(Uring *u, Sessao *s) {
+    if (s->marcada) return;
+    s->marcada = true;
+    s->proxima = u->marcadas;
+    u->marcadas = s;
+}
+
+static void marcaDistribuida(void *contexto, Sessao *s) {
+    marca(contexto, s);
+}
+
+// Fecha quando não houver mais operações pendentes; o shutdown faz as pendentes terminarem
+static void encerra(Uring *u, Sessao *s) {
+    if (!s->encerrar) {
+        s->encerrar = true;
+        shutdown(s->socket, SHUT_RDWR);
+    }
+    marca(u, s);
+}
+
+static void trataAceite(Uring *u, struct io_uring_cqe *cqe) {
+    if (!(cqe->flags & IORING_CQE_F_MORE)) armaAceite(u);
+    if (cqe->res < 0) {
+        if (cqe->res != -ECONNABORTED && cqe->res != -EINTR) fprintf(stderr, "Erro ao aceitar conexão: %s\n", strerror(-cqe->res));
+        return;
+    }
+
+    int client_socket = cqe->res;
+    int flag = 1;
+    setsockopt(client_socket, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+    Sessao *sessao = criaSessao(client_socket);
+    if (!sessao) {
+        close(client_socket);
+        return;
+    }
+    armaRecepcao(u, sessao);
+    registraLog("client connected\n");
+}
+
+static void trataRecepcao(Uring *u, Sessao *s, struct io_uring_cqe *cqe) {
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        s->recepcao = RECEPCAO_PARADA; // Rearmada no descarregamento, se for o caso
+        marca(u, s);
+    }
+
+    if (cqe->res > 0) {
+        uint16_t id = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+        int falhou = anelEscreve(&s->entrada, u->memoria_buffers + (size_t)id * TAMANHO_BUFFER, cqe->res);
+        devolveBuffer(u, id);
+        if (metricas_thread) somaContador(&metricas_thread->bytes_recebidos, cqe->res);
+        if (s->encerrar) return;
+        if (falhou == -1 || !processaEntrada(s)) encerra(u, s);
+        else marca(u, s);
+    } else if (cqe->res == 0) {
+        registraLog("client desconnected\n");
+        encerra(u, s);
+    } else if (cqe->res != -ENOBUFS && cqe->res != -ECANCELED) {
+        encerra(u, s); // Sem buffers livres o recv só é rearmado
+    }
+}
+
+static void trataEnvio(Uring *u, Sessao *s, struct io_uring_cqe *cqe) {
+    s->envios--;
+    marca(u, s);
+    if (cqe->res > 0) {
+        s->blocos_lote -= consomeSaida(&s->enviando, &s->blocos, cqe->res);
+        registraAtividade(s);
+        if (metricas_thread) somaContador(&metricas_thread->bytes_enviados, cqe->res);
+    } else if (cqe->res < 0 && cqe->res != -ECANCELED) {
+        encerra(u, s); // ECANCELED: encadeado depois de um envio curto, o resto é reenviado
+    }
+}
+
+// Fim da volta para uma sessão: retoma a leitura se as respostas foram consumidas, entrega
+// ao kernel as respostas acumuladas e ajusta a recepção à pausa
+static void descarrega(Uring *u, Sessao *s) {
+    s->marcada = false;
+    if (s->encerrar) {
+        if (s->envios == 0 && s->recepcao == RECEPCAO_PARADA) {
+            int socket = s->socket;
+            liberaSessao(s); // Antes do close, como no epoll
+            close(socket);
+        } else if (s->recepcao == RECEPCAO_ATIVA) {
+            cancelaRecepcao(u, s);
+        }
+        return;
+    }
+
+    if (s->pausada && pendentesSaida(s) <= SAIDA_BAIXA) {
+        s->pausada = false;
+        if (!processaEntrada(s)) {
+            encerra(u, s); // Volta para a lista e é fechada na próxima passagem
+            return;
+        }
+    }
+
+    ressincronizaSala(s);
+
+    // Um lote de envios por vez: o anel em envio fica parado enquanto o kernel o lê, e as
+    // respostas novas se acumulam no outro anel. Blocos que chegam durante o lote entram na
+    // fila depois dos que estão com o kernel
+    if (s->envios == 0) {
+        if (s->enviando.tamanho == 0 && s->blocos_lote == 0) {
+            if (s->saida.tamanho > 0) {
+                Anel vazio = s->enviando;
+                s->enviando = s->saida;
+                s->saida = vazio;
+            }
+            s->blocos_lote = s->blocos.tamanho;
+        }
+        if (s->enviando.tamanho > 0 || s->blocos_lote > 0) armaEnvios(u, s);
+        else anelEncolhe(&s->enviando, SAIDA_RETIDA);
+    }
+
+    if (leituraSuspensa(s) && s->recepcao == RECEPCAO_ATIVA) cancelaRecepcao(u, s);
+    else if (!leituraSuspensa(s) && s->recepcao == RECEPCAO_PARADA) armaRecepcao(u, s);
+}
+
+static void disparaUring(void *contexto, Temporizador *t) {
+    Sessao *s;
+    int acao = disparaTemporizador(t, &s);
+    if (acao == TEMPORIZADOR_ENCERRA) encerra(contexto, s);
+    else if (acao == TEMPORIZADOR_DESCARREGA) marca(contexto, s);
+}
+
+void loopUring(Uring *u) {
+    armaAceite(u);
+    armaAviso(u);
+    while (1) {
+        // Esperando conclusões, como no epoll_wait: até o próximo temporizador e sem
+        // ponteiros de labirinto sem referência (recarga.h)
+        int espera = esperaRoda(roda_thread, agoraNs());
+        saiVolta();
+        int r = uringEspera(u->fd, u->preparadas, espera);
+        entraVolta();
+        if (r < 0 && errno == ETIME) r = 0; // Nada submetido e nenhuma conclusão no prazo
+        if (r < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY) continue;
+            // Sem o laço a porta deste worker deixaria de ser atendida: melhor parar tudo
+            perror("Erro no io_uring_enter; encerrando o servidor");
+            exit(EXIT_FAILURE);
+        }
+        u->preparadas -= r;
+        avancaRoda(roda_thread, agoraNs(), disparaUring, u);
+
+        unsigned head = *u->cq_head;
+        unsigned tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            struct io_uring_cqe *cqe = &u->cqes[head & u->cq_mascara];
+            Sessao *s = (Sessao *)(uintptr_t)(cqe->user_data & ~OP_MASCARA);
+            switch (cqe->user_data & OP_MASCARA) {
+                case OP_ACEITE: trataAceite(u, cqe); break;
+                case OP_RECEPCAO: trataRecepcao(u, s, cqe); break;
+                case OP_ENVIO: trataEnvio(u, s, cqe); break;
+                case OP_AVISO:
+                    recebeAviso(u->salas);
+                    armaAviso(u);
+                    break;
+                default: break;
+            }
+        }
+        __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+        __atomic_store_n(&u->buffers->tail, u->buffers_tail, __ATOMIC_RELEASE);
+
+        publicaSalas();
+        distribuiSalas(marcaDistribuida, u);
+
+        while (u->marcadas) {
+            Sessao *s = u->marcadas;
+            u->marcadas = s->proxima;
+            descarrega(u, s);
+        }
+    }
+}
+
+// Operações usadas pelo transporte, no probe do kernel
+static bool operacoesSuportadas(Uring *u) {
+    static const uint8_t usadas[] = {IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SEND, IORING_OP_READ, IORING_OP_ASYNC_CANCEL};
+    struct io_uring_probe *probe = calloc(1, sizeof(*probe) + IORING_OP_LAST * sizeof(struct io_uring_probe_op));
+    if (!probe) return false;
+    bool suportadas = uringRegister(u->fd, IORING_REGISTER_PROBE, probe, IORING_OP_LAST) == 0;
+    for (size_t i = 0; suportadas && i < sizeof(usadas); i++) {
+        suportadas = usadas[i] <= probe->last_op && (probe->ops[usadas[i]].flags & IO_URING_OP_SUPPORTED);
+    }
+    free(probe);
+    return suportadas;
+}
+
+// O recv multishot (Linux 6.0+) não aparece nas features nem no probe, e sem ele cada recv
+// falharia com EINVAL: um recv de teste em um par de sockets mostra se o kernel o aceita.
+// Antes do laço, então as conclusões do teste são as únicas do anel
+static bool recepcaoMultishot(Uring *u) {
+    int par[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, par) == -1) return false;
+    struct io_uring_sqe *sqe = obtemSqe(u, OP_RECEPCAO);
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = par[0];
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = GRUPO_BUFFERS;
+
+    uint8_t byte = 0;
+    bool aceito = false, terminou = false, falhou = write(par[1], &byte, 1) != 1;
+    while (!terminou && !falhou) {
+        int r = uringEnter(u->fd, u->preparadas, 1, IORING_ENTER_GETEVENTS);
+        if (r < 0) {
+            falhou = errno != EINTR;
+            continue;
+        }
+        u->preparadas -= r;
+        unsigned head = *u->cq_head, tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            struct io_uring_cqe *cqe = &u->cqes[head & u->cq_mascara];
+            if (cqe->res > 0) {
+                // O byte chegou e a recepção continua armada: o shutdown a termina
+                aceito = aceito || (cqe->flags & IORING_CQE_F_MORE);
+                devolveBuffer(u, (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT));
+                shutdown(par[0], SHUT_RDWR);
+            }
+            if (!(cqe->flags & IORING_CQE_F_MORE)) terminou = true;
+        }
+        __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&u->buffers->tail, u->buffers_tail, __ATOMIC_RELEASE);
+    close(par[0]);
+    close(par[1]);
+    return aceito && !falhou;
+}
+
+Uring *criaUring(int server_socket) {
+    Uring *u = calloc(1, sizeof(Uring));
+    if (!u) return NULL;
+    u->server_socket = server_socket;
+    u->salas = salas_thread;
+    uint8_t *filas = MAP_FAILED;
+    size_t tamanho = 0;
+
+    // Só esta thread submete, e as conclusões são processadas apenas quando ela pede
+    struct io_uring_params p = {0};
+    p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+    p.cq_entries = URING_CONCLUSOES;
+    u->fd = uringSetup(URING_ENTRADAS, &p);
+    if (u->fd < 0 && errno == EINVAL) {
+        memset(&p, 0, sizeof(p));
+        p.flags = IORING_SETUP_CQSIZE;
+        p.cq_entries = URING_CONCLUSOES;
+        u->fd = uringSetup(URING_ENTRADAS, &p);
+    }
+    // EXT_ARG (5.11) dá o prazo do io_uring_enter até o próximo temporizador
+    if (u->fd < 0 || !(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_FAST_POLL)
+        || !(p.features & IORING_FEAT_EXT_ARG) || !operacoesSuportadas(u)) {
+        goto falha;
+    }
+
+    size_t sq_tamanho = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    size_t cq_tamanho = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    tamanho = sq_tamanho > cq_tamanho ? sq_tamanho : cq_tamanho;
+    filas = mmap(NULL, tamanho, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+    u->sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   u->fd, IORING_OFF_SQES);
+    if (filas == MAP_FAILED || u->sqes == MAP_FAILED) goto falha;
+
+    u->sq_head = (unsigned *)(filas + p.sq_off.head);
+    u->sq_tail = (unsigned *)(filas + p.sq_off.tail);
+    u->sq_array = (unsigned *)(filas + p.sq_off.array);
+    u->sq_mascara = *(unsigned *)(filas + p.sq_off.ring_mask);
+    u->sq_entradas = p.sq_entries;
+    u->cq_head = (unsigned *)(filas + p.cq_off.head);
+    u->cq_tail = (unsigned *)(filas + p.cq_off.tail);
+    u->cq_mascara = *(unsigned *)(filas + p.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe *)(filas + p.cq_off.cqes);
+
+    // Anel de buffers fornecidos (Linux 5.19+)
+    u->buffers = mmap(NULL, BUFFERS_RECEPCAO * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    u->memoria_buffers = malloc((size_t)BUFFERS_RECEPCAO * TAMANHO_BUFFER);
+    if (u->buffers == MAP_FAILED || !u->memoria_buffers) goto falha;
+    struct io_uring_buf_reg registro = {0};
+    registro.ring_addr = (uintptr_t)u->buffers;
+    registro.ring_entries = BUFFERS_RECEPCAO;
+    registro.bgid = GRUPO_BUFFERS;
+    if (uringRegister(u->fd, IORING_REGISTER_PBUF_RING, &registro, 1) < 0) goto falha;
+    for (int i = 0; i < BUFFERS_RECEPCAO; i++) devolveBuffer(u, (uint16_t)i);
+    __atomic_store_n(&u->buffers->tail, u->buffers_tail, __ATOMIC_RELEASE);
+    if (!recepcaoMultishot(u)) goto falha;
+
+    // O io_uring espera conexões por conta própria; com O_NONBLOCK o accept falharia com EAGAIN
+    int flags = fcntl(server_socket, F_GETFL, 0);
+    fcntl(server_socket, F_SETFL, flags & ~O_NONBLOCK);
+    return u;
+
+falha:
+    // A sondagem de EXT_ARG e do recv multishot chega aqui em kernels antigos: nada pode vazar
+    if (filas != MAP_FAILED) munmap(filas, tamanho);
+    if (u->sqes && u->sqes != MAP_FAILED) munmap(u->sqes, p.sq_entries * sizeof(struct io_uring_sqe));
+    if (u->buffers && u->buffers != MAP_FAILED) munmap(u->buffers, BUFFERS_RECEPCAO * sizeof(struct io_uring_buf));
+    if (u->fd >= 0) close(u->fd);
+    free(u->memoria_buffers);
+    free(u);
+    return NULL;
+}
@@ -0,0 +1,14 @@
+#ifndef URING_H
+#define URING_H
+
+// Transporte io_uring de um worker (Linux 6.0+): accept e recv multishot, recepção em um
+// anel de buffers fornecidos ao kernel e envios encadeados. Cada volta do laço faz uma única
+// chamada io_uring_enter, que submete tudo o que foi preparado e colhe as conclusões.
+
+typedef struct Uring Uring;
+
+// Retorna NULL se o kernel não oferece os recursos necessários (o worker usa epoll)
+Uring *criaUring(int server_socket);
+void loopUring(Uring *uring);
+
+#endif